@@ -0,0 +1,11 @@
+// A translation unit as it would appear in a client, see `make bench_compile'.
+#include BENCH_HEADER
+
+long fib(long i){
+    if(i < 2) return i;
+    return fib(i-1) + fib(i-2);
+}
+
+long cached_fib(memoization::memory& c, long i){
+    return CACHED(c, fib, i);
+}
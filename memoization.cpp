@@ -0,0 +1,1139 @@
+/**
+ * Compiled parts of the memoization library: logging, file I/O and the
+ * disk cache, including serialization of common result types.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#include "memoization_disk_impl.hpp"
+#include "memoization_mapped.hpp"
+#include "memoization_numa.hpp"
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <boost/filesystem/operations.hpp>
+#include <boost/filesystem/path.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/serialization/string.hpp>
+#include <boost/serialization/vector.hpp>
+#include <zlib.h>
+#include <fcntl.h>
+#include <sys/xattr.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#include <sched.h>
+#include <linux/mempolicy.h>
+#include <unistd.h>
+#include <link.h>
+#include <elf.h>
+
+#if defined(__linux__) && defined(__has_include)
+#  if __has_include(<linux/io_uring.h>)
+#    include <linux/io_uring.h>
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    define MEMOIZATION_HAVE_IO_URING 1
+#  endif
+#endif
+
+namespace memoization{
+    namespace fs = boost::filesystem;
+
+    namespace detail{
+        bool log_enabled(log_level){
+            return boost::log::core::get()->get_logging_enabled();
+        }
+        void log(log_level level, const std::string& message){
+            if(level == warning)
+                BOOST_LOG_TRIVIAL(warning) << message;
+            else
+                BOOST_LOG_TRIVIAL(info) << message;
+        }
+
+        std::string current_directory(){
+            return fs::current_path().string();
+        }
+
+        std::string pack(const char* data, std::size_t n){
+            uLongf len = compressBound(n);
+            std::string packed(len, '\0');
+            // the fastest level: packing runs in the background, unpacking on hits
+            if(compress2(reinterpret_cast<Bytef*>(&packed[0]), &len, reinterpret_cast<const Bytef*>(data), n, 1) != Z_OK)
+                throw std::runtime_error("cannot compress cache entry");
+            packed.resize(len);
+            packed.shrink_to_fit();
+            return packed;
+        }
+        void unpack(const std::string& packed, char* data, std::size_t n){
+            uLongf len = n;
+            if(uncompress(reinterpret_cast<Bytef*>(data), &len, reinterpret_cast<const Bytef*>(packed.data()), packed.size()) != Z_OK
+                    || len != n)
+                throw std::runtime_error("cannot decompress cache entry");
+        }
+
+        /// runs task every interval on a thread of its own, until destroyed.
+        class periodic{
+            std::mutex m_mutex;
+            std::condition_variable m_wakeup;
+            bool m_stop;
+            std::thread m_thread;
+          public:
+            periodic(std::chrono::milliseconds interval, std::function<void()> task);
+            ~periodic();
+        };
+
+        periodic::periodic(std::chrono::milliseconds interval, std::function<void()> task):m_stop(false){
+            m_thread = std::thread([this, interval, task](){
+                std::unique_lock<std::mutex> lock(m_mutex);
+                while(!m_wakeup.wait_for(lock, interval, [this]{ return m_stop; })){
+                    lock.unlock();
+                    task();
+                    lock.lock();
+                }
+            });
+        }
+        periodic::~periodic(){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wakeup.notify_all();
+            m_thread.join();
+        }
+
+        unsigned numa_nodes(){
+            unsigned long mask[16] = {0};
+            if(::syscall(SYS_get_mempolicy, NULL, mask, sizeof(mask) * 8, NULL, MPOL_F_MEMS_ALLOWED) != 0)
+                return 1;
+            unsigned nodes = 1;
+            for(unsigned i = 0; i < sizeof(mask) * 8; i++)
+                if(mask[i / (8 * sizeof(long))] & (1ul << (i % (8 * sizeof(long)))))
+                    nodes = i + 1;
+            return nodes;
+        }
+        namespace{
+            // the node of each CPU, from sysfs lists like "0-3,8-11"
+            std::vector<unsigned> cpu_nodes(){
+                std::vector<unsigned> nodes;
+                for(unsigned node = 0; node < numa_nodes(); node++){
+                    std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                    unsigned first, last;
+                    while(in >> first){
+                        last = first;
+                        if(in.peek() == '-')
+                            in.ignore() >> last;
+                        last = std::max(first, last);
+                        if(nodes.size() <= last)
+                            nodes.resize(last + 1, 0);
+                        std::fill(nodes.begin() + first, nodes.begin() + last + 1, node);
+                        if(in.peek() == ',')
+                            in.ignore();
+                    }
+                }
+                return nodes;
+            }
+        }
+        unsigned current_node(){
+            // sched_getcpu is answered by the vDSO, getcpu would be a system call on every lookup
+            static const std::vector<unsigned> nodes = cpu_nodes();
+            int cpu = ::sched_getcpu();
+            if(cpu < 0 || unsigned(cpu) >= nodes.size())
+                return 0;
+            return nodes[cpu];
+        }
+
+        void heavy_hitters::access(std::size_t key, bool hit){
+            (hit ? m_hits : m_misses)++;
+            if(!m_k)
+                return;
+            auto it = m_index.find(key);
+            if(it == m_index.end()){
+                buckets::iterator in;
+                if(m_index.size() < m_k){
+                    in = m_buckets.insert(std::make_pair(0, bucket())).first;
+                    hot_key h = {key, 0, 0, 0, 0};
+                    in->second.push_front(h);
+                }else{
+                    // take over a counter with the smallest count
+                    in = m_buckets.begin();
+                    hot_key& h = in->second.front();
+                    m_index.erase(h.seed);
+                    h.seed = key;
+                    h.error = h.count;
+                    h.hits = 0;
+                    h.seconds = 0;
+                }
+                position pos = {in, in->second.begin()};
+                it = m_index.insert(std::make_pair(key, pos)).first;
+            }
+            // move the counter into the bucket of the next count, which follows its current one
+            position& pos = it->second;
+            std::uint64_t count = pos.in->first + 1;
+            buckets::iterator next = std::next(pos.in);
+            if(next == m_buckets.end() || next->first != count)
+                next = m_buckets.insert(next, std::make_pair(count, bucket()));
+            next->second.splice(next->second.begin(), pos.in->second, pos.at);
+            if(pos.in->second.empty())
+                m_buckets.erase(pos.in);
+            pos.in = next;
+            pos.at->count = count;
+            pos.at->hits += hit;
+        }
+        std::uint64_t heavy_hitters::count(std::size_t key)const{
+            auto it = m_index.find(key);
+            return it == m_index.end() ? 0 : it->second.at->count;
+        }
+        void heavy_hitters::clear(){
+            m_index.clear();
+            m_buckets.clear();
+        }
+        void heavy_hitters::computed(std::size_t key, double seconds){
+            auto it = m_index.find(key);
+            if(it != m_index.end())
+                it->second.at->seconds += seconds;
+        }
+        std::vector<hot_key> heavy_hitters::top()const{
+            std::vector<hot_key> keys;
+            for(auto b = m_buckets.rbegin(); b != m_buckets.rend(); ++b)
+                keys.insert(keys.end(), b->second.begin(), b->second.end());
+            return keys;
+        }
+
+        std::uint64_t next_object_id(){
+            static std::atomic<std::uint64_t> next(0);
+            return ++next;
+        }
+
+        std::uint64_t identity_generation(const std::shared_ptr<const void>& p){
+            static std::mutex mutex;
+            static std::map<const void*, std::pair<std::weak_ptr<const void>, std::uint64_t> > known;
+            static std::size_t sweep_at = 64;
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& k = known[p.get()];
+            const std::weak_ptr<const void>& w = k.first;
+            // a new object at the address of a destroyed one gets a new number
+            if(w.expired() || w.owner_before(p) || p.owner_before(w)){
+                k.first = p;
+                k.second = next_object_id();
+            }
+            std::uint64_t g = k.second;
+            if(known.size() >= sweep_at){
+                for(auto it = known.begin(); it != known.end(); )
+                    if(it->second.first.expired())
+                        it = known.erase(it);
+                    else
+                        ++it;
+                sweep_at = 2 * known.size() + 64;
+            }
+            return g;
+        }
+    }
+
+    void memory::compress_cold(std::chrono::milliseconds age){
+        m_packer.reset();
+        if(age.count() > 0)
+            m_packer = std::make_shared<detail::periodic>(std::max(age / 2, std::chrono::milliseconds(1)),
+                    [this, age](){ pack_unused(age); });
+    }
+    void memory::pack_unused(std::chrono::milliseconds age){
+        std::vector<std::size_t> cold;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            cold = m_ledger.unused_since(std::chrono::steady_clock::now() - age);
+        }
+        for(std::size_t seed : cold){
+            detail::any_value value;
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_data.find(seed);
+                if(it == m_data.end() || it->second.packed())
+                    continue;
+                value = it->second;
+            }
+            // compress without holding the lock; lookups meanwhile see the original
+            detail::any_value packed = value.pack();
+            if(packed.empty())
+                continue;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_data.find(seed);
+            if(it == m_data.end() || !it->second.same(value))
+                continue;
+            m_ledger.resize(seed, sizeof(packed) + packed.packed_size());
+            it->second = std::move(packed);
+        }
+    }
+
+    namespace detail{
+        int find_build_id(dl_phdr_info* info, std::size_t, void* data){
+            std::string& id = *static_cast<std::string*>(data);
+            for(int i = 0; i < info->dlpi_phnum && id.empty(); i++){
+                const ElfW(Phdr)& ph = info->dlpi_phdr[i];
+                if(ph.p_type != PT_NOTE)
+                    continue;
+                const char* p = reinterpret_cast<const char*>(info->dlpi_addr + ph.p_vaddr);
+                const char* end = p + ph.p_memsz;
+                while(p + sizeof(ElfW(Nhdr)) <= end){
+                    const ElfW(Nhdr)* note = reinterpret_cast<const ElfW(Nhdr)*>(p);
+                    const char* name = p + sizeof(ElfW(Nhdr));
+                    const unsigned char* desc = reinterpret_cast<const unsigned char*>(name + ((note->n_namesz + 3) & ~3u));
+                    if(note->n_type == NT_GNU_BUILD_ID && note->n_namesz == 4 && std::memcmp(name, "GNU", 4) == 0){
+                        static const char hex[] = "0123456789abcdef";
+                        for(unsigned j = 0; j < note->n_descsz; j++){
+                            id += hex[desc[j] >> 4];
+                            id += hex[desc[j] & 15];
+                        }
+                        break;
+                    }
+                    p = reinterpret_cast<const char*>(desc) + ((note->n_descsz + 3) & ~3u);
+                }
+            }
+            return 1; // the executable comes first, stop there
+        }
+    }
+
+    std::string build_id(){
+        std::string id;
+        dl_iterate_phdr(detail::find_build_id, &id);
+        if(!id.empty())
+            return id;
+        struct stat st;
+        if(::stat("/proc/self/exe", &st) != 0)
+            throw std::runtime_error("cannot identify the executable");
+        return "exe-" + std::to_string(st.st_size) + "-" + std::to_string(st.st_mtime);
+    }
+
+    namespace detail{
+        token_bucket::token_bucket(double rate)
+            :m_rate(rate), m_tokens(rate), m_last(std::chrono::steady_clock::now()){}
+        void token_bucket::take(double n){
+            if(m_rate <= 0)
+                return;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for(;;){
+                auto now = std::chrono::steady_clock::now();
+                m_tokens = std::min(m_rate, m_tokens + m_rate * std::chrono::duration<double>(now - m_last).count());
+                m_last = now;
+                // more than a burst at once is allowed when the bucket is full, and paid off afterwards
+                double need = std::min(n, m_rate);
+                if(m_tokens >= need){
+                    m_tokens -= n;
+                    return;
+                }
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::duration<double>((need - m_tokens) / m_rate));
+                lock.lock();
+            }
+        }
+
+        write_behind::write_behind(const disk& d, double bytes_per_second, double ops_per_second, std::size_t max_queued)
+            :m_bytes(bytes_per_second), m_ops(ops_per_second), m_disk(d), m_max_queued(max_queued), m_queued(0),
+             m_writing(false), m_stop(false){
+            m_thread = std::thread(&write_behind::work, this);
+        }
+        write_behind::~write_behind(){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wakeup.notify_all();
+            m_thread.join();
+        }
+        bool write_behind::push(std::shared_ptr<entry> e){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if(m_queued + e->data.size() > m_max_queued)
+                    return false;
+                m_queued += e->data.size();
+                m_pending[e->fn] = e;
+                m_queue.push_back(e);
+            }
+            m_wakeup.notify_all();
+            return true;
+        }
+        std::shared_ptr<const write_behind::entry> write_behind::pending(const std::string& fn){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            auto it = m_pending.find(fn);
+            if(it == m_pending.end())
+                return std::shared_ptr<const entry>();
+            return it->second;
+        }
+        void write_behind::cancel(const std::string& fn){
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for(const auto& e : m_queue)
+                if(e->fn == fn)
+                    e->cancelled = true;
+            if(m_current && m_current->fn == fn)
+                m_current->cancelled = true;
+            m_pending.erase(fn);
+            // the caller may remove the file once the write is done, but not before
+            m_written.wait(lock, [this, &fn]{ return !m_writing || m_current->fn != fn; });
+        }
+        void write_behind::flush(){
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]{ return m_queue.empty() && m_pending.empty(); });
+        }
+        void write_behind::work(){
+            std::unique_lock<std::mutex> lock(m_mutex);
+            for(;;){
+                m_wakeup.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+                if(m_queue.empty())
+                    return; // stopped, and everything is written
+                std::shared_ptr<entry> e = m_queue.front();
+                m_queue.pop_front();
+                m_current = e;
+                if(!e->cancelled){
+                    lock.unlock();
+                    m_bytes.take(e->data.size());
+                    m_ops.take(1);
+                    lock.lock();
+                }
+                // cancelled while waiting for tokens, or else the write completes before cancel() returns
+                if(!e->cancelled){
+                    m_writing = true;
+                    lock.unlock();
+                    // lookups may read the queued data meanwhile
+                    m_disk.write_now(e->descr, e->fn, e->data, e->digest);
+                    lock.lock();
+                    m_writing = false;
+                }
+                m_current.reset();
+                m_written.notify_all();
+                m_queued -= e->data.size();
+                // a newer entry for the same file may be queued
+                auto it = m_pending.find(e->fn);
+                if(it != m_pending.end() && it->second == e)
+                    m_pending.erase(it);
+                if(m_queue.empty())
+                    m_idle.notify_all();
+            }
+        }
+
+        thread_pool::thread_pool(std::size_t n_threads):m_stop(false){
+            // without workers, run_all would wait forever
+            for(std::size_t i = 0; i < std::max(n_threads, std::size_t(1)); i++)
+                m_threads.push_back(std::thread([this]{ work(); }));
+        }
+        thread_pool::~thread_pool(){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_wakeup.notify_all();
+            for(auto& t : m_threads)
+                t.join();
+        }
+        void thread_pool::post(std::function<void()> task){
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_tasks.push_back(std::move(task));
+            }
+            m_wakeup.notify_one();
+        }
+        void thread_pool::run_all(std::size_t n, const std::function<void(std::size_t)>& f){
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::size_t remaining = n;
+            for(std::size_t i = 0; i < n; i++)
+                post([&, i]{
+                    f(i);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if(--remaining == 0)
+                        finished.notify_one();
+                });
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [&]{ return remaining == 0; });
+        }
+        void thread_pool::work(){
+            for(;;){
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(m_mutex);
+                    m_wakeup.wait(lock, [this]{ return m_stop || !m_tasks.empty(); });
+                    if(m_tasks.empty())
+                        return;
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::uint64_t digest(const char* data, std::size_t n){
+            std::uint64_t h = 14695981039346656037ull;
+            for(std::size_t i = 0; i < n; i++){
+                h ^= static_cast<unsigned char>(data[i]);
+                h *= 1099511628211ull;
+            }
+            return h;
+        }
+
+        bool read_file(io::request& r){
+            int fd = ::open(r.path.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd < 0)
+                return false;
+            struct stat st;
+            bool ok = ::fstat(fd, &st) == 0;
+            if(ok)
+                r.data.resize(st.st_size);
+            for(std::size_t done = 0; ok && done < r.data.size(); ){
+                ssize_t n = ::pread(fd, &r.data[done], r.data.size() - done, done);
+                if(n < 0 && errno == EINTR)
+                    continue;
+                ok = n > 0;
+                done += ok ? n : 0;
+            }
+            ::close(fd);
+            return ok;
+        }
+        std::size_t round_up(std::size_t n){
+            return (n + direct_io_alignment - 1) / direct_io_alignment * direct_io_alignment;
+        }
+        // opens with O_DIRECT, or without on file systems that do not support it
+        int open_direct(const std::string& path, int flags, bool& direct){
+#ifdef O_DIRECT
+            int fd = ::open(path.c_str(), flags | O_DIRECT, 0644);
+            direct = fd >= 0;
+            if(direct || errno != EINVAL)
+                return fd;
+#endif
+            direct = false;
+            return ::open(path.c_str(), flags, 0644);
+        }
+        bool read_direct(const std::string& path, aligned_buffer& buf){
+            bool direct;
+            int fd = open_direct(path, O_RDONLY | O_CLOEXEC, direct);
+            if(fd < 0)
+                return false;
+            struct stat st;
+            bool ok = ::fstat(fd, &st) == 0;
+            std::size_t size = ok ? st.st_size : 0;
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+            buf.resize(round_up(size));
+            std::size_t done = 0;
+            while(ok && done < size){
+                ssize_t n = ::pread(fd, &buf[done], buf.size() - done, done);
+                if(n < 0 && errno == EINTR)
+                    continue;
+                ok = n > 0;
+                done += ok ? n : 0;
+            }
+            buf.resize(size);
+            if(!direct)
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            ::close(fd);
+            return ok;
+        }
+        bool pwrite_all(int fd, const char* data, std::size_t n, std::size_t offset){
+            for(std::size_t done = 0; done < n; ){
+                ssize_t w = ::pwrite(fd, data + done, n - done, offset + done);
+                if(w < 0 && errno == EINTR)
+                    continue;
+                if(w <= 0)
+                    return false;
+                done += w;
+            }
+            return true;
+        }
+        bool write_direct(const std::string& path, const aligned_buffer& buf){
+            bool direct;
+            int fd = open_direct(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, direct);
+            if(fd < 0)
+                return false;
+            std::size_t size = buf.size();
+            std::size_t whole = size / direct_io_alignment * direct_io_alignment;
+            bool ok = pwrite_all(fd, buf.data(), whole, 0);
+            if(ok && whole < size){
+                // O_DIRECT writes whole blocks: the tail goes through a padded block, truncated below
+                aligned_buffer tail(direct_io_alignment, 0);
+                std::copy(buf.begin() + whole, buf.end(), tail.begin());
+                ok = pwrite_all(fd, tail.data(), tail.size(), whole);
+            }
+            ok = ok && ::ftruncate(fd, size) == 0;
+            if(ok && !direct){
+                // dirty pages cannot be dropped, so write them out first
+                ok = ::fdatasync(fd) == 0;
+                ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+            }
+            return ::close(fd) == 0 && ok;
+        }
+
+        bool write_file(const io::request& r){
+            int fd = ::open(r.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if(fd < 0)
+                return false;
+            bool ok = true;
+            for(std::size_t done = 0; ok && done < r.data.size(); ){
+                ssize_t n = ::pwrite(fd, &r.data[done], r.data.size() - done, done);
+                if(n < 0 && errno == EINTR)
+                    continue;
+                ok = n > 0;
+                done += ok ? n : 0;
+            }
+            return ::close(fd) == 0 && ok;
+        }
+
+#ifdef MEMOIZATION_HAVE_IO_URING
+        // the ring behind io::uring_engine
+        class uring{
+            int m_fd;
+            unsigned m_depth;
+            void* m_sq_ring;
+            void* m_cq_ring;
+            std::size_t m_sq_ring_size, m_cq_ring_size;
+            io_uring_sqe* m_sqes;
+            std::size_t m_sqes_size;
+            unsigned *m_sq_tail, *m_sq_mask, *m_sq_array;
+            unsigned *m_cq_head, *m_cq_tail, *m_cq_mask;
+            io_uring_cqe* m_cqes;
+            std::mutex m_mutex; // one batch at a time owns the ring
+
+            struct state{
+                int fd;
+                bool opening;
+                std::size_t done;
+            };
+          public:
+            explicit uring(unsigned depth){
+                io_uring_params p;
+                std::memset(&p, 0, sizeof(p));
+                m_fd = ::syscall(__NR_io_uring_setup, depth, &p);
+                if(m_fd < 0)
+                    throw std::system_error(errno, std::system_category(), "io_uring_setup");
+                m_depth = p.sq_entries;
+                m_sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+                m_cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+                bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+                if(single_mmap)
+                    m_sq_ring_size = m_cq_ring_size = std::max(m_sq_ring_size, m_cq_ring_size);
+                m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+                m_sq_ring = ::mmap(NULL, m_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+                m_cq_ring = single_mmap ? m_sq_ring
+                    : ::mmap(NULL, m_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+                void* sqes = ::mmap(NULL, m_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+                m_sqes = static_cast<io_uring_sqe*>(sqes);
+                if(m_sq_ring == MAP_FAILED || m_cq_ring == MAP_FAILED || sqes == MAP_FAILED){
+                    int err = errno;
+                    release();
+                    throw std::system_error(err, std::system_category(), "mmap of io_uring");
+                }
+                char* sq = static_cast<char*>(m_sq_ring);
+                char* cq = static_cast<char*>(m_cq_ring);
+                m_sq_tail  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+                m_sq_mask  = reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+                m_sq_array = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+                m_cq_head  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+                m_cq_tail  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+                m_cq_mask  = reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+                m_cqes     = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+                if(!supported()){
+                    release();
+                    throw std::system_error(EOPNOTSUPP, std::system_category(), "io_uring lacks openat/read/write");
+                }
+            }
+            ~uring(){ release(); }
+
+            void read(std::vector<io::request>& reqs){ run(reqs, false); }
+            void write(std::vector<io::request>& reqs){ run(reqs, true); }
+
+          private:
+            uring(const uring&);
+            uring& operator=(const uring&);
+
+            void release(){
+                if(m_sqes && m_sqes != MAP_FAILED) ::munmap(static_cast<void*>(m_sqes), m_sqes_size);
+                if(m_cq_ring && m_cq_ring != MAP_FAILED && m_cq_ring != m_sq_ring) ::munmap(m_cq_ring, m_cq_ring_size);
+                if(m_sq_ring && m_sq_ring != MAP_FAILED) ::munmap(m_sq_ring, m_sq_ring_size);
+                m_sqes = NULL;
+                m_sq_ring = m_cq_ring = NULL;
+                if(m_fd >= 0) ::close(m_fd);
+                m_fd = -1;
+            }
+            bool supported(){
+                const unsigned n_ops = 256;
+                std::vector<char> buf(sizeof(io_uring_probe) + n_ops * sizeof(io_uring_probe_op), 0);
+                io_uring_probe* probe = reinterpret_cast<io_uring_probe*>(&buf[0]);
+                if(::syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, n_ops) < 0)
+                    return false;
+                const int ops[] = {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE};
+                for(int op : ops)
+                    if(op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED))
+                        return false;
+                return true;
+            }
+            void push(const io_uring_sqe& sqe){
+                unsigned tail = *m_sq_tail;
+                unsigned index = tail & *m_sq_mask;
+                m_sqes[index] = sqe;
+                m_sq_array[index] = index;
+                __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+            }
+            bool pop(io_uring_cqe& cqe){
+                unsigned head = *m_cq_head;
+                if(head == __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE))
+                    return false;
+                cqe = m_cqes[head & *m_cq_mask];
+                __atomic_store_n(m_cq_head, head + 1, __ATOMIC_RELEASE);
+                return true;
+            }
+            void enter(unsigned to_submit){
+                while(::syscall(__NR_io_uring_enter, m_fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0) < 0){
+                    if(errno != EINTR)
+                        throw std::system_error(errno, std::system_category(), "io_uring_enter");
+                    to_submit = 0; // the kernel consumed the submissions before being interrupted
+                }
+            }
+            void prepare(io_uring_sqe& sqe, std::vector<io::request>& reqs, std::vector<state>& st, std::size_t i, bool writing){
+                std::memset(&sqe, 0, sizeof(sqe));
+                sqe.user_data = i;
+                if(st[i].opening){
+                    sqe.opcode = IORING_OP_OPENAT;
+                    sqe.fd = AT_FDCWD;
+                    sqe.addr = reinterpret_cast<std::uintptr_t>(reqs[i].path.c_str());
+                    sqe.open_flags = writing ? O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC : O_RDONLY | O_CLOEXEC;
+                    sqe.len = 0644;
+                    return;
+                }
+                std::string& data = reqs[i].data;
+                sqe.opcode = writing ? IORING_OP_WRITE : IORING_OP_READ;
+                sqe.fd = st[i].fd;
+                sqe.addr = reinterpret_cast<std::uintptr_t>(&data[0] + st[i].done);
+                sqe.len = std::min<std::size_t>(data.size() - st[i].done, 1u << 30);
+                sqe.off = st[i].done;
+            }
+            void finish(io::request& r, state& s, bool ok){
+                if(s.fd >= 0)
+                    ok = ::close(s.fd) == 0 && ok;
+                s.fd = -1;
+                r.ok = ok;
+            }
+            void run(std::vector<io::request>& reqs, bool writing){
+                std::lock_guard<std::mutex> lock(m_mutex);
+                state initial = {-1, true, 0};
+                std::vector<state> st(reqs.size(), initial);
+                std::deque<std::size_t> ready; // requests with a pending read or write
+                std::size_t next_open = 0;
+                unsigned in_flight = 0;
+                for(;;){
+                    unsigned queued = 0;
+                    while(in_flight + queued < m_depth){
+                        std::size_t i;
+                        if(!ready.empty()){
+                            i = ready.front();
+                            ready.pop_front();
+                        }else if(next_open < reqs.size())
+                            i = next_open++;
+                        else
+                            break;
+                        io_uring_sqe sqe;
+                        prepare(sqe, reqs, st, i, writing);
+                        push(sqe);
+                        queued++;
+                    }
+                    in_flight += queued;
+                    if(in_flight == 0)
+                        break;
+                    enter(queued);
+                    io_uring_cqe cqe;
+                    while(pop(cqe)){
+                        in_flight--;
+                        std::size_t i = cqe.user_data;
+                        io::request& r = reqs[i];
+                        state& s = st[i];
+                        if(cqe.res == -EINTR || cqe.res == -EAGAIN){
+                            ready.push_back(i); // try again
+                            continue;
+                        }
+                        if(cqe.res < 0){
+                            finish(r, s, false);
+                            continue;
+                        }
+                        if(s.opening){
+                            s.opening = false;
+                            s.fd = cqe.res;
+                            struct stat sb;
+                            if(!writing){
+                                if(::fstat(s.fd, &sb) != 0){
+                                    finish(r, s, false);
+                                    continue;
+                                }
+                                r.data.resize(sb.st_size);
+                            }
+                        }else if(cqe.res == 0 && s.done < r.data.size()){
+                            finish(r, s, false); // file shrank under us
+                            continue;
+                        }else if(cqe.res > 0)
+                            s.done += cqe.res;
+                        if(s.done == r.data.size())
+                            finish(r, s, true);
+                        else
+                            ready.push_back(i);
+                    }
+                }
+            }
+        };
+#else
+        class uring{
+          public:
+            explicit uring(unsigned){
+                throw std::system_error(ENOSYS, std::system_category(), "built without io_uring");
+            }
+            void read(std::vector<io::request>&){}
+            void write(std::vector<io::request>&){}
+        };
+#endif
+    }
+
+    namespace io{
+        thread_pool_engine::thread_pool_engine(std::size_t n_threads):m_pool(n_threads){}
+        void thread_pool_engine::read(std::vector<request>& reqs){
+            m_pool.run_all(reqs.size(), [&](std::size_t i){ reqs[i].ok = detail::read_file(reqs[i]); });
+        }
+        void thread_pool_engine::write(std::vector<request>& reqs){
+            m_pool.run_all(reqs.size(), [&](std::size_t i){ reqs[i].ok = detail::write_file(reqs[i]); });
+        }
+
+        uring_engine::uring_engine(unsigned depth):m_ring(new detail::uring(depth)){}
+        uring_engine::~uring_engine(){}
+        void uring_engine::read(std::vector<request>& reqs){ m_ring->read(reqs); }
+        void uring_engine::write(std::vector<request>& reqs){ m_ring->write(reqs); }
+
+        std::shared_ptr<engine> make_engine(unsigned depth){
+            try{
+                return std::make_shared<uring_engine>(depth);
+            }catch(const std::system_error& e){
+                MEMOIZATION_LOG(info) << "io_uring unavailable (" << e.what() << "), using threads";
+            }
+            return std::make_shared<thread_pool_engine>(std::min(depth, 16u));
+        }
+    }
+
+    disk::disk(std::string path)
+    :m_path((fs::path(path) / "cache").string()), m_dir(m_path), m_accounting(false), m_direct_threshold(0), m_sync(false){
+        fs::create_directories(m_path);
+    }
+    void disk::set_generation(const std::string& g){
+        m_dir = g.empty() ? m_path : (fs::path(m_path) / ("gen-" + g)).string();
+        fs::create_directories(m_dir);
+        m_prior.clear();
+        std::vector<std::pair<std::time_t, std::string> > dirs;
+        for(fs::directory_iterator it(m_path), end; it != end; ++it)
+            if(fs::is_directory(it->status()) && !fs::equivalent(it->path(), m_dir)
+                    && it->path().filename().string().compare(0, 4, "gen-") == 0)
+                dirs.push_back(std::make_pair(fs::last_write_time(it->path()), it->path().string()));
+        std::sort(dirs.rbegin(), dirs.rend());
+        for(const auto& d : dirs)
+            m_prior.push_back(d.second);
+    }
+    void disk::remove_old_generations(){
+        for(const std::string& p : m_prior)
+            fs::remove_all(p);
+        m_prior.clear();
+    }
+    std::string disk::filename(const std::string& descr, std::size_t seed)const{
+        std::string fn = descr + "-" + std::to_string(seed);
+        return (fs::path(m_dir) / fn).string();
+    }
+    void disk::erase(const std::string& descr, std::size_t seed)const{
+        std::string fn = filename(descr, seed);
+        if(m_writer)
+            m_writer->cancel(fn);
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ledger.erase(fn);
+        }
+        boost::system::error_code ec;
+        fs::remove(fn, ec);
+    }
+    void disk::carry_over(const std::string& descr, std::size_t seed)const{
+        if(m_prior.empty() || !m_stable.count(descr))
+            return;
+        std::string fn = filename(descr, seed);
+        if(fs::exists(fn))
+            return;
+        fs::path name = fs::path(fn).filename();
+        for(const std::string& p : m_prior){
+            boost::system::error_code ec;
+            fs::create_hard_link(fs::path(p) / name, fn, ec);
+            if(!ec){
+                MEMOIZATION_LOG(info) << "Carried over "<<name<<" from "<<p;
+                return;
+            }
+        }
+    }
+    std::string disk::temporary(const std::string& fn){
+        return fs::unique_path(fn + "-%%%%%%%%.tmp").string();
+    }
+    namespace{
+        const char* const digest_attribute = "user.memoization.digest";
+    }
+    bool disk::unchanged(const std::string& fn, const char* data, std::size_t n, std::uint64_t digest)const{
+        struct stat st;
+        if(::stat(fn.c_str(), &st) != 0 || std::size_t(st.st_size) != n)
+            return false;
+        std::uint64_t stored;
+        bool same;
+        if(::getxattr(fn.c_str(), digest_attribute, &stored, sizeof(stored)) == sizeof(stored))
+            same = stored == digest;
+        else{
+            // written without a digest (or on a file system without xattrs)
+            io::request r(fn);
+            same = detail::read_file(r) && r.data.size() == n && std::memcmp(r.data.data(), data, n) == 0;
+        }
+        if(same){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_accounting)
+                m_ledger.touch(fn);
+        }
+        return same;
+    }
+    void disk::commit(const std::string& descr, const std::string& tmp, const std::string& fn, std::uint64_t digest)const{
+        ::setxattr(tmp.c_str(), digest_attribute, &digest, sizeof(digest), 0); // optional, see unchanged()
+        if(m_sync){
+            int fd = ::open(tmp.c_str(), O_RDONLY | O_CLOEXEC);
+            if(fd >= 0){
+                ::fsync(fd);
+                ::close(fd);
+            }
+        }
+        fs::rename(tmp, fn);
+        std::vector<std::string> victims;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_accounting)
+                victims = m_ledger.insert(descr, fn, fs::file_size(fn));
+        }
+        for(const std::string& victim : victims){
+            if(m_writer)
+                m_writer->m_ops.take(1);
+            fs::remove(victim);
+        }
+    }
+    std::size_t disk::expected_size(const std::string& descr)const{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_entry_size.find(descr);
+        return it == m_entry_size.end() ? 0 : it->second;
+    }
+    void disk::record_size(const std::string& descr, std::size_t bytes)const{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entry_size[descr] = bytes;
+    }
+    void disk::store(const std::string& descr, const std::string& fn, detail::aligned_buffer& data, std::uint64_t digest)const{
+        if(!m_writer){
+            write_now(descr, fn, data, digest);
+            return;
+        }
+        std::shared_ptr<detail::write_behind::entry> e = std::make_shared<detail::write_behind::entry>();
+        e->descr = descr;
+        e->fn = fn;
+        e->data.swap(data);
+        e->digest = digest;
+        e->cancelled = false;
+        if(!m_writer->push(e)){
+            MEMOIZATION_LOG(warning) << "Write queue full, not storing "<<fn;
+        }
+    }
+    void disk::write_now(const std::string& descr, const std::string& fn, const detail::aligned_buffer& data, std::uint64_t digest)const{
+        if(unchanged(fn, data.data(), data.size(), digest)){
+            MEMOIZATION_LOG(info) << "Cache file "<<fn<<" is up to date";
+            return;
+        }
+        // write aside and rename, so that concurrent readers never see partial files
+        std::string tmp = temporary(fn);
+        bool ok;
+        if(m_direct_threshold && data.size() >= m_direct_threshold)
+            ok = detail::write_direct(tmp, data);
+        else{
+            std::ofstream ofs(tmp, std::ios::binary);
+            ok = bool(ofs.write(data.data(), data.size()));
+        }
+        if(!ok){
+            MEMOIZATION_LOG(warning) << "Could not write cache file "<<tmp;
+            std::remove(tmp.c_str());
+            return;
+        }
+        commit(descr, tmp, fn, digest);
+    }
+    void disk::set_write_limit(double bytes_per_second, double ops_per_second, std::size_t max_queued){
+        m_writer.reset();
+        if(bytes_per_second > 0 || ops_per_second > 0)
+            m_writer.reset(new detail::write_behind(*this, bytes_per_second, ops_per_second, max_queued));
+    }
+    void disk::flush(){
+        if(m_writer)
+            m_writer->flush();
+    }
+    void disk::start_accounting(){
+        if(m_accounting)
+            return;
+        m_accounting = true;
+        std::vector<std::pair<std::time_t, fs::path> > files;
+        for(fs::directory_iterator it(m_dir), end; it != end; ++it)
+            if(fs::is_regular_file(it->status()) && it->path().extension() != ".tmp")
+                files.push_back(std::make_pair(fs::last_write_time(it->path()), it->path()));
+        std::sort(files.begin(), files.end());
+        for(const auto& f : files){
+            std::string name = f.second.filename().string();
+            std::size_t dash = name.rfind('-');
+            if(dash == std::string::npos)
+                continue;
+            for(const std::string& victim : m_ledger.insert(name.substr(0, dash), f.second.string(), fs::file_size(f.second)))
+                fs::remove(victim);
+        }
+    }
+
+    // file layout of mapped_memory: the header, then tables and values at offsets from the start
+    struct mapped_memory::header{
+        std::uint64_t magic;
+        std::uint64_t used;    // end of allocated space
+        std::uint64_t table;   // offset of the slot table
+        std::uint64_t slots;   // a power of two
+        std::uint64_t entries;
+    };
+    struct mapped_memory::slot{
+        std::uint64_t seed;
+        std::uint64_t offset;  // of the value, zero for free slots
+        std::uint64_t bytes;
+    };
+    namespace{
+        const std::uint64_t mapped_magic = 0x316d656d6f697a65ull; // format version in the top byte
+        const std::size_t mapped_alignment = 16;
+    }
+
+    mapped_memory::mapped_memory(const std::string& path, std::size_t initial_size)
+    :m_path(path), m_fd(-1), m_base(NULL), m_size(0){
+        m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if(m_fd < 0)
+            throw std::system_error(errno, std::system_category(), "cannot open " + path);
+        struct stat st;
+        if(::flock(m_fd, LOCK_EX | LOCK_NB) != 0 || ::fstat(m_fd, &st) != 0){
+            int err = errno;
+            ::close(m_fd);
+            throw std::system_error(err, std::system_category(), "cannot lock " + path);
+        }
+        bool fresh = st.st_size == 0;
+        m_size = fresh ? std::max(initial_size, std::size_t(4096)) : st.st_size;
+        if(fresh && ::ftruncate(m_fd, m_size) != 0){
+            int err = errno;
+            ::close(m_fd);
+            throw std::system_error(err, std::system_category(), "cannot resize " + path);
+        }
+        void* p = ::mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if(p == MAP_FAILED){
+            int err = errno;
+            ::close(m_fd);
+            throw std::system_error(err, std::system_category(), "cannot map " + path);
+        }
+        m_base = static_cast<char*>(p);
+        if(!fresh && (m_size < sizeof(header) || head().magic != mapped_magic)){
+            ::munmap(m_base, m_size);
+            ::close(m_fd);
+            throw std::runtime_error(path + " is not a mapped memoization cache");
+        }
+        if(!fresh && !consistent()){
+            MEMOIZATION_LOG(warning) << "Mapped cache "<<path<<" is damaged, starting over";
+            fresh = true;
+        }
+        if(fresh){
+            header& h = head();
+            h.used = sizeof(header);
+            h.slots = 64;
+            h.entries = 0;
+            h.table = allocate(h.slots * sizeof(slot));
+            h.magic = mapped_magic;
+        }
+    }
+    mapped_memory::~mapped_memory(){
+        ::munmap(m_base, m_size);
+        ::close(m_fd);
+    }
+    std::size_t mapped_memory::size()const{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return head().entries;
+    }
+    void mapped_memory::flush()const{
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ::msync(m_base, m_size, MS_SYNC);
+    }
+    bool mapped_memory::consistent()const{
+        const header& h = head();
+        return h.used >= sizeof(header) && h.used <= m_size
+            && h.slots && !(h.slots & (h.slots - 1)) && h.entries < h.slots
+            && h.table >= sizeof(header) && h.table <= h.used
+            && h.slots <= (h.used - h.table) / sizeof(slot);
+    }
+    mapped_memory::slot* mapped_memory::table()const{
+        return reinterpret_cast<slot*>(m_base + head().table);
+    }
+    mapped_memory::slot* mapped_memory::find_slot(std::uint64_t seed)const{
+        slot* t = table();
+        std::uint64_t mask = head().slots - 1;
+        std::uint64_t i = detail::hash_combine(0, seed) & mask;
+        for(std::uint64_t n = 0; n <= mask; n++, i = (i + 1) & mask)
+            if(!t[i].offset || t[i].seed == seed)
+                return &t[i];
+        return NULL; // only in a damaged file, which has no free slot left
+    }
+    void mapped_memory::reserve(std::size_t bytes){
+        if(head().used + bytes <= m_size)
+            return;
+        std::size_t size = std::max(2 * m_size, head().used + bytes);
+        size = (size + 4095) & ~std::size_t(4095);
+        if(::ftruncate(m_fd, size) != 0)
+            throw std::system_error(errno, std::system_category(), "cannot resize " + m_path);
+        // offsets stay valid when the mapping moves
+        void* p = ::mremap(m_base, m_size, size, MREMAP_MAYMOVE);
+        if(p == MAP_FAILED)
+            throw std::system_error(errno, std::system_category(), "cannot map " + m_path);
+        m_base = static_cast<char*>(p);
+        m_size = size;
+    }
+    std::uint64_t mapped_memory::allocate(std::size_t bytes){
+        bytes = (bytes + mapped_alignment - 1) & ~(mapped_alignment - 1);
+        reserve(bytes);
+        std::uint64_t offset = head().used;
+        head().used += bytes;
+        std::memset(m_base + offset, 0, bytes);
+        return offset;
+    }
+    void mapped_memory::grow_table(){
+        std::uint64_t old = head().table, n = head().slots;
+        std::uint64_t fresh = allocate(2 * n * sizeof(slot));
+        head().slots = 2 * n;
+        head().table = fresh;
+        const slot* o = reinterpret_cast<const slot*>(m_base + old);
+        for(std::uint64_t i = 0; i < n; i++)
+            if(o[i].offset)
+                *find_slot(o[i].seed) = o[i];
+    }
+    const char* mapped_memory::find(std::uint64_t seed, std::size_t& bytes)const{
+        const slot* s = find_slot(seed);
+        // a slot pointing outside the allocated space is a miss, like an unreadable file
+        if(!s || !s->offset || s->offset < sizeof(header) || s->offset > head().used
+                || s->bytes > head().used - s->offset)
+            return NULL;
+        bytes = s->bytes;
+        return m_base + s->offset;
+    }
+    void mapped_memory::store(std::uint64_t seed, const char* data, std::size_t bytes){
+        if(2 * (head().entries + 1) > head().slots)
+            grow_table();
+        // the value is complete before the slot refers to it
+        std::uint64_t offset = allocate(std::max(bytes, std::size_t(1)));
+        if(bytes)
+            std::memcpy(m_base + offset, data, bytes);
+        slot* s = find_slot(seed);
+        if(!s){
+            grow_table();
+            s = find_slot(seed);
+        }
+        if(!s->offset)
+            head().entries++;
+        s->seed = seed;
+        s->bytes = bytes;
+        s->offset = offset;
+    }
+
+    MEMOIZATION_DISK_INSTANTIATIONS()
+}
@@ -0,0 +1,59 @@
+/**
+ * Lookup tables of constexpr functions, computed at compile time.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_CONSTEXPR_HPP_295387__
+#     define __MEMOIZATION_CONSTEXPR_HPP_295387__
+#include "memoization_core.hpp"
+
+#define TABULATED(func, lo, hi) \
+    memoization::constexpr_table<decltype(func(lo)), decltype(lo), func, lo, hi>()
+
+namespace memoization{
+    namespace detail{
+        // index sequences of logarithmic instantiation depth, for large tables
+        template<typename A, typename B>
+            struct concat_indices;
+        template<std::size_t... I, std::size_t... J>
+            struct concat_indices<index_sequence<I...>, index_sequence<J...> >{
+                typedef index_sequence<I..., (sizeof...(I) + J)...> type;
+            };
+        template<std::size_t N>
+            struct make_index_range{
+                typedef typename concat_indices<typename make_index_range<N / 2>::type,
+                                                typename make_index_range<N - N / 2>::type>::type type;
+            };
+        template<>
+            struct make_index_range<0>{ typedef index_sequence<> type; };
+        template<>
+            struct make_index_range<1>{ typedef index_sequence<0> type; };
+
+        template<typename R, typename Arg, R (*F)(Arg), Arg Lo, typename Indices>
+            struct constexpr_values;
+        template<typename R, typename Arg, R (*F)(Arg), Arg Lo, std::size_t... Is>
+            struct constexpr_values<R, Arg, F, Lo, index_sequence<Is...> >{
+                static constexpr R values[sizeof...(Is)] = {F(Lo + Arg(Is))...};
+            };
+        template<typename R, typename Arg, R (*F)(Arg), Arg Lo, std::size_t... Is>
+            constexpr R constexpr_values<R, Arg, F, Lo, index_sequence<Is...> >::values[sizeof...(Is)];
+    }
+
+    /**
+     * All results of a constexpr function F for arguments in [Lo, Hi),
+     * computed by the compiler into a read-only table. Called like a
+     * memoized function; arguments outside the domain are passed to F.
+     * See the TABULATED macro, which deduces the types.
+     */
+    template<typename R, typename Arg, R (*F)(Arg), Arg Lo, Arg Hi>
+    struct constexpr_table{
+        static_assert(Lo < Hi, "the domain of a constexpr_table must not be empty");
+        typedef detail::constexpr_values<R, Arg, F, Lo, typename detail::make_index_range<std::size_t(Hi - Lo)>::type> values_t;
+        constexpr R operator()(Arg a)const{
+            return (a >= Lo && a < Hi) ? values_t::values[a - Lo] : F(a);
+        }
+        static constexpr std::size_t size(){ return std::size_t(Hi - Lo); }
+    };
+}
+#endif /* __MEMOIZATION_CONSTEXPR_HPP_295387__ */
@@ -0,0 +1,1228 @@
+/**
+ * Core of the memoization library: hashing, the in-memory caches and
+ * memoize. Does not depend on Boost.Serialization or Boost.Filesystem;
+ * the disk cache lives in memoization_disk.hpp.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_CORE_HPP_295387__
+#     define __MEMOIZATION_CORE_HPP_295387__
+#include <map>
+#include <list>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <mutex>
+#include <future>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <type_traits>
+#include <memory>
+#include <tuple>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cmath>
+#include <boost/functional/hash.hpp>
+#include <boost/optional.hpp>
+
+#define CACHED(cache, func, ...) cache(#func, func, __VA_ARGS__)
+// a single statement, also after an unbraced if
+#define MEMOIZATION_LOG(level) \
+    for(bool once = memoization::detail::log_enabled(memoization::detail::level); once; once = false) \
+        memoization::detail::log_line(memoization::detail::level).stream()
+
+namespace memoization{
+    namespace detail{
+        enum log_level{ info, warning };
+        // implemented with Boost.Log in memoization.cpp
+        bool log_enabled(log_level level);
+        void log(log_level level, const std::string& message);
+
+        // collects a message and logs it when going out of scope
+        class log_line{
+            log_level m_level;
+            std::ostringstream m_os;
+          public:
+            explicit log_line(log_level level):m_level(level){}
+            ~log_line(){ log(m_level, m_os.str()); }
+            std::ostream& stream(){ return m_os; }
+        };
+
+        // implemented with zlib in memoization.cpp
+        std::string pack(const char* data, std::size_t n);
+        void unpack(const std::string& packed, char* data, std::size_t n);
+
+        // values which are a contiguous array of trivially copyable elements can be packed
+        template<typename T>
+            struct flat_array{ static const bool value = false; };
+        template<typename T, typename A>
+            struct flat_array<std::vector<T, A> >{
+                static const bool value = std::is_trivially_copyable<T>::value && !std::is_same<T, bool>::value;
+                typedef T element_type;
+            };
+        template<typename C, typename T, typename A>
+            struct flat_array<std::basic_string<C, T, A> >{
+                static const bool value = true;
+                typedef C element_type;
+            };
+
+        template<typename T>
+            typename std::enable_if<flat_array<T>::value, bool>::type
+            pack_value(const T& v, std::string& packed, std::size_t& n){
+                n = v.size();
+                packed = pack(reinterpret_cast<const char*>(v.data()), n * sizeof(typename flat_array<T>::element_type));
+                return true;
+            }
+        template<typename T>
+            typename std::enable_if<!flat_array<T>::value, bool>::type
+            pack_value(const T&, std::string&, std::size_t&){ return false; }
+        template<typename T>
+            typename std::enable_if<flat_array<T>::value, T>::type
+            unpack_value(const std::string& packed, std::size_t n){
+                T v(n, typename flat_array<T>::element_type());
+                unpack(packed, reinterpret_cast<char*>(&v[0]), n * sizeof(typename flat_array<T>::element_type));
+                return v;
+            }
+        template<typename T>
+            typename std::enable_if<!flat_array<T>::value, T>::type
+            unpack_value(const std::string&, std::size_t){ throw std::logic_error("value cannot be packed"); }
+
+        /**
+         * Holds a value of any copyable type, like boost::any. Values are
+         * immutable and shared by copies. Vectors and strings of trivially
+         * copyable elements can be packed (compressed) and unpacked.
+         */
+        class any_value{
+            struct base{
+                virtual ~base(){}
+                virtual bool pack(std::string& packed, std::size_t& n)const = 0;
+            };
+            template<typename T>
+            struct holder : base{
+                T value;
+                explicit holder(const T& v):value(v){}
+                bool pack(std::string& packed, std::size_t& n)const{ return pack_value(value, packed, n); }
+            };
+            std::shared_ptr<const base> m_held;
+            const std::type_info* m_type;
+            std::string m_packed;
+            std::size_t m_count; // elements of the packed value
+          public:
+            any_value():m_type(NULL), m_count(0){}
+            template<typename T>
+                any_value(const T& v):m_held(std::make_shared<holder<T> >(v)), m_type(&typeid(T)), m_count(0){}
+            template<typename T>
+                const T& get()const{
+                    const holder<T>* h = dynamic_cast<const holder<T>*>(m_held.get());
+                    if(!h)
+                        throw std::runtime_error(std::string("cached value is not a ") + typeid(T).name());
+                    return h->value;
+                }
+            bool empty()const{ return !m_type; }
+            bool packed()const{ return m_type && !m_held; }
+            std::size_t packed_size()const{ return m_packed.size(); }
+            /// whether o is a copy of this value
+            bool same(const any_value& o)const{ return m_held && m_held == o.m_held; }
+            /// a packed copy, or an empty value if this one cannot be packed.
+            any_value pack()const{
+                any_value p;
+                if(m_held && m_held->pack(p.m_packed, p.m_count))
+                    p.m_type = m_type;
+                return p;
+            }
+            template<typename T>
+                void unpack(){
+                    if(!packed())
+                        return;
+                    if(*m_type != typeid(T))
+                        throw std::runtime_error(std::string("cached value is not a ") + typeid(T).name());
+                    m_held = std::make_shared<holder<T> >(unpack_value<T>(m_packed, m_count));
+                    std::string().swap(m_packed);
+                }
+        };
+
+        // runs a task periodically on a thread of its own, in memoization.cpp
+        class periodic;
+    }
+
+    /**
+     * Limits on the entries of a cache.
+     *
+     * Used both for the capacity of a whole cache and for the quota of a
+     * single descr. Zero limits are unlimited. When the whole cache is
+     * over capacity, entries are evicted from the descr which uses most
+     * relative to its weight, so each descr keeps a share of the cache
+     * proportional to its weight.
+     */
+    struct quota{
+        std::size_t max_entries;
+        std::size_t max_bytes;
+        double weight;
+        quota(std::size_t entries = 0, std::size_t bytes = 0, double w = 1.0)
+            :max_entries(entries), max_bytes(bytes), weight(w){}
+    };
+
+    /// what a descr (or the whole cache) currently occupies.
+    struct usage{
+        std::size_t entries;
+        std::size_t bytes;
+    };
+
+    /// one of the most frequently looked up keys of a descr.
+    struct hot_key{
+        std::size_t seed;
+        std::uint64_t count;   // lookups, overestimated by at most error
+        std::uint64_t error;
+        std::uint64_t hits;    // lookups answered from the cache, since tracked
+        double seconds;        // spent computing its result, since tracked
+    };
+
+    /// what is known about the entries of a descr, see memory::stats().
+    struct statistics{
+        usage used;
+        std::uint64_t hits;
+        std::uint64_t misses;
+        std::vector<hot_key> hot; // most frequent first
+    };
+
+    namespace detail{
+        /// a new process-unique number.
+        std::uint64_t next_object_id();
+        /// process-unique number of the object owned by p; never reused, even if its address is.
+        std::uint64_t identity_generation(const std::shared_ptr<const void>& p);
+    }
+
+    /**
+     * Argument which is keyed by the identity of a shared object instead
+     * of its content, e.g. a large model which is never modified.
+     *
+     * Only a weak reference is kept in the key, and memory and typed_memory
+     * drop entries of destroyed objects. Keys are meaningful only within
+     * one process, so the persistent caches reject them at compile time.
+     * Converts to the shared_ptr, so memoized functions may take that
+     * instead.
+     */
+    template<typename T>
+    class identity{
+        const T* m_object;
+        std::weak_ptr<const T> m_owner;
+        std::uint64_t m_generation;
+      public:
+        explicit identity(const std::shared_ptr<T>& p)
+            :m_object(p.get()), m_owner(p), m_generation(detail::identity_generation(p)){}
+        const T& operator*()const{ return *m_object; }
+        const T* operator->()const{ return m_object; }
+        operator std::shared_ptr<const T>()const{ return m_owner.lock(); }
+        const std::weak_ptr<const T>& owner()const{ return m_owner; }
+        std::uint64_t generation()const{ return m_generation; }
+
+        friend bool operator==(const identity& a, const identity& b){ return a.m_generation == b.m_generation; }
+        friend std::size_t hash_value(const identity& i){ return boost::hash<std::uint64_t>()(i.m_generation); }
+    };
+
+    template<typename T>
+    identity<T> by_identity(const std::shared_ptr<T>& p){
+        return identity<T>(p);
+    }
+
+    namespace detail{
+        // arguments whose keys mean nothing in another process, which persistent caches reject
+        template<typename T>
+            struct process_local : std::false_type{};
+        template<typename... Params>
+            struct any_process_local : std::false_type{};
+        template<typename T, typename... Params>
+            struct any_process_local<T, Params...> : std::integral_constant<bool,
+                process_local<typename std::decay<T>::type>::value || any_process_local<Params...>::value>{};
+        template<typename T>
+            struct process_local<identity<T> > : std::true_type{};
+        template<typename... Args>
+            struct process_local<std::tuple<Args...> > : any_process_local<Args...>{};
+        template<typename A, typename B>
+            struct process_local<std::pair<A, B> > : any_process_local<A, B>{};
+
+        /// instantiated by the caches which keep entries beyond the process.
+        template<typename... Params>
+            struct assert_persistent_keys{
+                static_assert(!any_process_local<Params...>::value,
+                        "identity and versioned keys are only valid within one process, use a memory cache");
+            };
+    }
+
+    namespace detail{
+        template <typename T>
+            size_t hash_combine(std::size_t seed, const T& t) {
+                boost::hash_combine(seed, t);
+                return seed;
+            }
+        template <typename T, typename... Params>
+            size_t hash_combine(std::size_t seed, const T& t, const Params&... params) {
+                boost::hash_combine(seed, t);
+                return hash_combine(seed, params...);
+            }
+
+        template<std::size_t... Is> struct index_sequence{};
+        template<std::size_t N, std::size_t... Is>
+            struct make_index_sequence : make_index_sequence<N-1, N-1, Is...>{};
+        template<std::size_t... Is>
+            struct make_index_sequence<0, Is...> : index_sequence<Is...>{};
+
+        /**
+         * An element of a batch is either the single argument of a
+         * function or a tuple of all of its arguments.
+         */
+        template<typename Arg>
+        struct batch_args{
+            template<typename Func>
+                struct result{ typedef decltype(std::declval<const Func&>()(std::declval<const Arg&>())) type; };
+            static std::size_t hash(std::size_t seed, const Arg& a){ return hash_combine(seed, a); }
+            template<typename Func>
+                static typename result<Func>::type apply(const Func& f, const Arg& a){ return f(a); }
+            template<typename P>
+                static Arg make(P&& p){ return Arg(std::forward<P>(p)); }
+        };
+        template<typename... Args>
+        struct batch_args<std::tuple<Args...> >{
+            template<typename Func>
+                struct result{ typedef decltype(std::declval<const Func&>()(std::declval<const Args&>()...)) type; };
+            static std::size_t hash(std::size_t seed, const std::tuple<Args...>& t){
+                return hash(seed, t, make_index_sequence<sizeof...(Args)>());
+            }
+            template<typename Func>
+                static typename result<Func>::type apply(const Func& f, const std::tuple<Args...>& t){
+                    return apply(f, t, make_index_sequence<sizeof...(Args)>());
+                }
+            template<typename... P>
+                static std::tuple<Args...> make(P&&... p){ return std::tuple<Args...>(std::forward<P>(p)...); }
+          private:
+            template<std::size_t... Is>
+                static std::size_t hash(std::size_t seed, const std::tuple<Args...>& t, index_sequence<Is...>){
+                    return hash_combine(seed, std::get<Is>(t)...);
+                }
+            template<typename Func, std::size_t... Is>
+                static typename result<Func>::type apply(const Func& f, const std::tuple<Args...>& t, index_sequence<Is...>){
+                    return f(std::get<Is>(t)...);
+                }
+        };
+
+        // element type E of a batch implementation taking a const std::vector<E>&
+        template<typename F>
+            struct batch_element : batch_element<decltype(&F::operator())>{};
+        template<typename R, typename E>
+            struct batch_element<R(*)(const std::vector<E>&)>{ typedef E type; };
+        template<typename C, typename R, typename E>
+            struct batch_element<R(C::*)(const std::vector<E>&)>{ typedef E type; };
+        template<typename C, typename R, typename E>
+            struct batch_element<R(C::*)(const std::vector<E>&)const>{ typedef E type; };
+
+        /**
+         * Collects the misses of concurrent callers until a time window has
+         * passed or enough misses are pending, then evaluates them together.
+         * The first caller of a window waits and evaluates for everybody.
+         */
+        template<typename Arg, typename R>
+        struct coalescer{
+            std::chrono::microseconds m_window;
+            std::size_t m_max_count;
+            std::mutex m_mutex;
+            std::condition_variable m_full;
+            std::vector<Arg> m_pending;
+            std::vector<std::promise<R> > m_promises;
+            bool m_collecting;
+
+            coalescer(std::chrono::microseconds window, std::size_t max_count)
+                :m_window(window), m_max_count(max_count), m_collecting(false){}
+
+            template<typename Evaluate>
+            R operator()(const Arg& a, const Evaluate& evaluate){
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_pending.push_back(a);
+                m_promises.push_back(std::promise<R>());
+                std::future<R> result = m_promises.back().get_future();
+                if(m_collecting){
+                    if(m_pending.size() >= m_max_count)
+                        m_full.notify_one();
+                    lock.unlock();
+                    return result.get();
+                }
+                m_collecting = true;
+                m_full.wait_for(lock, m_window, [this]{ return m_pending.size() >= m_max_count; });
+                std::vector<Arg> args;
+                std::vector<std::promise<R> > promises;
+                args.swap(m_pending);
+                promises.swap(m_promises);
+                m_collecting = false;
+                lock.unlock();
+
+                try{
+                    std::vector<R> results = evaluate(args);
+                    for(std::size_t i = 0; i < promises.size(); i++)
+                        promises[i].set_value(std::move(results[i]));
+                }catch(...){
+                    for(auto& p : promises)
+                        p.set_exception(std::current_exception());
+                }
+                return result.get();
+            }
+        };
+
+        // how an argument is stored in a typed table: decayed, C strings as std::string
+        template<typename T>
+            struct decayed_key_type{ typedef T type; };
+        template<>
+            struct decayed_key_type<const char*>{ typedef std::string type; };
+        template<>
+            struct decayed_key_type<char*>{ typedef std::string type; };
+        template<typename T>
+            struct key_type : decayed_key_type<typename std::decay<T>::type>{};
+
+        // owners of the identity arguments among params
+        inline void owners(std::vector<std::weak_ptr<const void> >&){}
+        template<typename T, typename... Params>
+            void owners(std::vector<std::weak_ptr<const void> >& v, const T&, const Params&... params){
+                owners(v, params...);
+            }
+        template<typename T, typename... Params>
+            void owners(std::vector<std::weak_ptr<const void> >& v, const identity<T>& i, const Params&... params){
+                v.push_back(i.owner());
+                owners(v, params...);
+            }
+
+        struct tuple_hash{
+            template<typename... Args>
+                std::size_t operator()(const std::tuple<Args...>& t)const{
+                    return batch_args<std::tuple<Args...> >::hash(0, t);
+                }
+        };
+
+        // rough number of bytes held by a value, used for memory quotas.
+        template <typename T>
+            std::size_t approx_size(const T&){ return sizeof(T); }
+        template <typename T, typename A>
+            std::size_t approx_size(const std::vector<T, A>& v){ return sizeof(v) + v.capacity() * sizeof(T); }
+        template <typename C, typename T, typename A>
+            std::size_t approx_size(const std::basic_string<C, T, A>& s){ return sizeof(s) + s.capacity() * sizeof(C); }
+
+        /**
+         * Finds the k most frequently used keys in a single pass with k
+         * counters (the space-saving algorithm): an untracked key replaces
+         * one with the smallest count and inherits that count as its
+         * possible error. Counters are kept in buckets of equal count
+         * (a stream summary), so that each access takes constant time.
+         * Implemented in memoization.cpp.
+         */
+        class heavy_hitters{
+            typedef std::list<hot_key> bucket;
+            typedef std::map<std::uint64_t, bucket> buckets; // by count, least frequent first
+            struct position{
+                buckets::iterator in;
+                bucket::iterator at;
+            };
+            std::size_t m_k;
+            buckets m_buckets;
+            std::unordered_map<std::size_t, position> m_index;
+            std::uint64_t m_hits, m_misses;
+          public:
+            explicit heavy_hitters(std::size_t k):m_k(k), m_hits(0), m_misses(0){}
+            heavy_hitters(const heavy_hitters&) = delete;
+            heavy_hitters& operator=(const heavy_hitters&) = delete;
+            void access(std::size_t key, bool hit);
+            /// the count of key, zero if it is not among the tracked keys.
+            std::uint64_t count(std::size_t key)const;
+            void clear();
+            void computed(std::size_t key, double seconds);
+            std::uint64_t hits()const{ return m_hits; }
+            std::uint64_t misses()const{ return m_misses; }
+            /// the tracked keys, most frequent first.
+            std::vector<hot_key> top()const;
+        };
+
+        /**
+         * Book-keeping for quotas: tracks entries per descr in LRU order
+         * and decides which entries must go when limits are exceeded. The
+         * cache itself is responsible for deleting the returned victims.
+         */
+        template <typename Key>
+        class quota_ledger{
+            struct account{
+                quota limits;
+                usage used;
+                std::list<Key> lru; // most recently used first
+                account(){ used.entries = used.bytes = 0; }
+            };
+            struct entry{
+                account* acc;
+                std::size_t bytes;
+                typename std::list<Key>::iterator pos;
+                std::chrono::steady_clock::time_point used;
+            };
+            quota m_capacity;
+            usage m_used;
+            std::map<std::string, account> m_accounts;
+            std::map<Key, entry> m_index;
+
+            static bool over(const quota& q, const usage& u){
+                return (q.max_entries && u.entries > q.max_entries)
+                    || (q.max_bytes && u.bytes > q.max_bytes);
+            }
+            // the account furthest above its weighted share of the capacity
+            account* heaviest(){
+                account* worst = NULL;
+                double worst_load = 0;
+                for(auto& a : m_accounts){
+                    if(a.second.used.entries == 0)
+                        continue;
+                    double n = m_capacity.max_bytes ? a.second.used.bytes : a.second.used.entries;
+                    double load = n / std::max(a.second.limits.weight, 1e-9);
+                    if(!worst || load > worst_load){
+                        worst = &a.second;
+                        worst_load = load;
+                    }
+                }
+                return worst;
+            }
+            Key evict(account& a){
+                Key k = a.lru.back();
+                erase(k);
+                return k;
+            }
+          public:
+            quota_ledger(){ m_used.entries = m_used.bytes = 0; }
+            void set_capacity(const quota& q){ m_capacity = q; }
+            void set_quota(const std::string& descr, const quota& q){ m_accounts[descr].limits = q; }
+            usage used()const{ return m_used; }
+            usage used(const std::string& descr)const{
+                auto it = m_accounts.find(descr);
+                if(it == m_accounts.end()){
+                    usage u = {0, 0};
+                    return u;
+                }
+                return it->second.used;
+            }
+            void touch(const Key& k){
+                auto it = m_index.find(k);
+                if(it == m_index.end())
+                    return;
+                std::list<Key>& lru = it->second.acc->lru;
+                lru.splice(lru.begin(), lru, it->second.pos);
+                it->second.used = std::chrono::steady_clock::now();
+            }
+            /// the size of an entry changed, without it being used.
+            void resize(const Key& k, std::size_t bytes){
+                auto it = m_index.find(k);
+                if(it == m_index.end())
+                    return;
+                it->second.acc->used.bytes += bytes - it->second.bytes;
+                m_used.bytes += bytes - it->second.bytes;
+                it->second.bytes = bytes;
+            }
+            /// keys which have not been used since t.
+            std::vector<Key> unused_since(std::chrono::steady_clock::time_point t)const{
+                std::vector<Key> keys;
+                for(const auto& a : m_accounts)
+                    for(auto k = a.second.lru.rbegin(); k != a.second.lru.rend(); ++k){
+                        if(!(m_index.find(*k)->second.used < t))
+                            break;
+                        keys.push_back(*k);
+                    }
+                return keys;
+            }
+            void erase(const Key& k){
+                auto it = m_index.find(k);
+                if(it == m_index.end())
+                    return;
+                account& a = *it->second.acc;
+                a.lru.erase(it->second.pos);
+                a.used.entries--;
+                a.used.bytes -= it->second.bytes;
+                m_used.entries--;
+                m_used.bytes -= it->second.bytes;
+                m_index.erase(it);
+            }
+            /// records a new entry and returns the keys which have to be evicted (possibly including k).
+            std::vector<Key> insert(const std::string& descr, const Key& k, std::size_t bytes){
+                erase(k);
+                account& a = m_accounts[descr];
+                a.lru.push_front(k);
+                entry e = {&a, bytes, a.lru.begin(), std::chrono::steady_clock::now()};
+                m_index[k] = e;
+                a.used.entries++;
+                a.used.bytes += bytes;
+                m_used.entries++;
+                m_used.bytes += bytes;
+
+                std::vector<Key> victims;
+                while(over(a.limits, a.used))
+                    victims.push_back(evict(a));
+                while(over(m_capacity, m_used))
+                    victims.push_back(evict(*heaviest()));
+                return victims;
+            }
+        };
+
+        /**
+         * What the caches have in common, written in terms of the derived
+         * Cache's get<R>(descr, seed) and put(descr, seed, value): the
+         * operator()s hash descr and the arguments into a seed and call
+         * lookup(), which gets the result or computes and puts it. A Cache
+         * may hide lookup(), get_many() or put_many() by its own. Persistent
+         * caches reject keys which are only valid within one process.
+         */
+        template<typename Cache, bool Persistent = false>
+        struct cache_base{
+            template<typename Func, typename... Params>
+                auto operator()(const Func& f, Params&&... params) const -> decltype(f(params...)){
+                    return self()("anonymous", f, std::forward<Params>(params)...);
+                }
+            template<typename Func, typename... Params>
+                auto operator()(const std::string& descr, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                    typedef typename std::conditional<Persistent, assert_persistent_keys<Params...>, std::false_type>::type check_keys;
+                    check_keys();
+                    std::size_t seed = hash_combine(0, descr, params...);
+                    return self().lookup(descr, seed, f, std::forward<Params>(params)...);
+                }
+            template<typename Func, typename... Params>
+                auto operator()(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                    boost::hash_combine(seed, descr);
+                    return self().lookup(descr, seed, f, std::forward<Params>(params)...);
+                }
+
+            template<typename R>
+                std::vector<boost::optional<R> > get_many(const std::string& descr, const std::vector<std::size_t>& seeds)const{
+                    std::vector<boost::optional<R> > ret;
+                    for(std::size_t seed : seeds)
+                        ret.push_back(self().template get<R>(descr, seed));
+                    return ret;
+                }
+            template<typename R>
+                void put_many(const std::string& descr, const std::vector<std::size_t>& seeds, const std::vector<R>& values)const{
+                    for(std::size_t i = 0; i < seeds.size(); i++)
+                        self().put(descr, seeds[i], values[i]);
+                }
+
+          protected:
+            const Cache& self()const{ return static_cast<const Cache&>(*this); }
+            template<typename Func, typename... Params>
+                auto lookup(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                    typedef decltype(f(params...)) retval_t;
+                    boost::optional<retval_t> cached = self().template get<retval_t>(descr, seed);
+                    if(cached)
+                        return std::move(*cached);
+                    retval_t ret = f(std::forward<Params>(params)...);
+                    MEMOIZATION_LOG(info) << "Non-cached access";
+                    self().put(descr, seed, ret);
+                    return ret;
+                }
+        };
+    }
+    struct memory : detail::cache_base<memory>{
+        mutable std::map<std::size_t, detail::any_value> m_data;
+        mutable detail::quota_ledger<std::size_t> m_ledger;
+        mutable std::mutex m_mutex;
+        // entries keyed by identity arguments, dropped when their object is gone
+        mutable std::vector<std::pair<std::weak_ptr<const void>, std::size_t> > m_watched;
+        mutable std::size_t m_sweep_at = 64;
+        mutable std::map<std::string, detail::heavy_hitters> m_hot;
+        std::size_t m_hot_k = 0;
+        std::shared_ptr<detail::periodic> m_packer; // declared last, stops first
+
+        /// limit the whole cache; sizes of values are estimated.
+        void set_capacity(const quota& q){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ledger.set_capacity(q);
+        }
+        /// limit the entries of one descr. Enforced when the descr next stores a result.
+        void set_quota(const std::string& descr, const quota& q){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_ledger.set_quota(descr, q);
+        }
+        usage used()const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_ledger.used();
+        }
+        usage used(const std::string& descr)const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_ledger.used(descr);
+        }
+        /**
+         * Compress entries which have not been used for the given time, in
+         * a background thread; they are decompressed on their next hit.
+         * Only vectors and strings of trivially copyable elements are
+         * compressed. Zero stops compressing.
+         */
+        void compress_cold(std::chrono::milliseconds age);
+        /// track the k most frequently looked up keys of each descr, reported by stats(). Zero stops tracking.
+        void track_hot(std::size_t k){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_hot_k = k;
+            m_hot.clear();
+        }
+        statistics stats(const std::string& descr)const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            statistics s = {m_ledger.used(descr), 0, 0, std::vector<hot_key>()};
+            auto it = m_hot.find(descr);
+            if(it != m_hot.end()){
+                s.hits = it->second.hits();
+                s.misses = it->second.misses();
+                s.hot = it->second.top();
+            }
+            return s;
+        }
+        /// drop entries with identity arguments whose objects were destroyed. Also done as the cache grows.
+        void drop_expired()const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            sweep();
+        }
+
+        using detail::cache_base<memory>::operator();
+        template<typename Func, typename... Params>
+            auto operator()(std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                return lookup("anonymous", seed, f, std::forward<Params>(params)...);
+            }
+
+        template<typename R>
+            boost::optional<R> get(const std::string& descr, std::size_t seed)const{
+                std::lock_guard<std::mutex> lock(m_mutex);
+                auto it = m_data.find(seed);
+                if(m_hot_k)
+                    hot(descr).access(seed, it != m_data.end());
+                if(it == m_data.end())
+                    return boost::none;
+                if(it->second.packed()){
+                    MEMOIZATION_LOG(info) << "Cached access from memory, decompressed";
+                    it->second.unpack<R>();
+                    boost::optional<R> ret(it->second.get<R>());
+                    for(std::size_t victim : m_ledger.insert(descr, seed, detail::approx_size(*ret)))
+                        m_data.erase(victim);
+                    return ret;
+                }
+                MEMOIZATION_LOG(info) << "Cached access from memory";
+                m_ledger.touch(seed);
+                return it->second.get<R>();
+            }
+        template<typename R>
+            void put(const std::string& descr, std::size_t seed, const R& value)const{
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_data[seed] = value;
+                for(std::size_t victim : m_ledger.insert(descr, seed, detail::approx_size(value)))
+                    m_data.erase(victim);
+            }
+      private:
+        friend struct detail::cache_base<memory>;
+        detail::heavy_hitters& hot(const std::string& descr)const{
+            auto it = m_hot.find(descr);
+            if(it == m_hot.end())
+                it = m_hot.emplace(std::piecewise_construct, std::forward_as_tuple(descr), std::forward_as_tuple(m_hot_k)).first;
+            return it->second;
+        }
+        void pack_unused(std::chrono::milliseconds age);
+        void sweep()const{
+            std::size_t kept = 0;
+            for(std::size_t i = 0; i < m_watched.size(); i++){
+                if(m_watched[i].first.expired()){
+                    m_data.erase(m_watched[i].second);
+                    m_ledger.erase(m_watched[i].second);
+                }else
+                    m_watched[kept++] = m_watched[i];
+            }
+            m_watched.resize(kept);
+            m_sweep_at = 2 * kept + 64;
+        }
+        void watch(std::size_t seed, const std::vector<std::weak_ptr<const void> >& owners)const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for(const auto& o : owners)
+                m_watched.push_back(std::make_pair(o, seed));
+            if(m_watched.size() >= m_sweep_at)
+                sweep();
+        }
+        template<typename Func, typename... Params>
+            auto lookup(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                typedef decltype(f(params...)) retval_t;
+                boost::optional<retval_t> cached = get<retval_t>(descr, seed);
+                if(cached)
+                    return std::move(*cached);
+                std::vector<std::weak_ptr<const void> > owners;
+                detail::owners(owners, params...);
+                auto start = std::chrono::steady_clock::now();
+                retval_t ret = f(std::forward<Params>(params)...);
+                MEMOIZATION_LOG(info) << "Non-cached access";
+                if(m_hot_k){
+                    std::chrono::duration<double> took = std::chrono::steady_clock::now() - start;
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    hot(descr).computed(seed, took.count());
+                }
+                put(descr, seed, ret);
+                if(!owners.empty())
+                    watch(seed, owners);
+                return ret;
+            }
+    };
+
+
+
+    /**
+     * In-memory cache with one statically typed table per descr and
+     * signature.
+     *
+     * The arguments themselves are the keys, so lookups are exact (no
+     * hash collisions) and values are stored without type erasure.
+     * Arguments must be hashable and equality comparable.
+     */
+    struct typed_memory{
+        template<typename R, typename... Args>
+        struct table{
+            typedef std::tuple<Args...> key_t;
+            std::mutex m_mutex;
+            std::unordered_map<key_t, R, detail::tuple_hash> m_data;
+            // entries keyed by identity arguments, dropped when their object is gone
+            std::vector<std::pair<std::weak_ptr<const void>, key_t> > m_watched;
+            std::size_t m_sweep_at = 64;
+
+            template<typename Func, typename... Params>
+                R operator()(const Func& f, Params&&... params){
+                    key_t key(params...);
+                    {
+                        std::lock_guard<std::mutex> lock(m_mutex);
+                        auto it = m_data.find(key);
+                        if(it != m_data.end()){
+                            MEMOIZATION_LOG(info) << "Cached access from typed memory";
+                            return it->second;
+                        }
+                    }
+                    std::vector<std::weak_ptr<const void> > owners;
+                    detail::owners(owners, params...);
+                    R ret = f(std::forward<Params>(params)...);
+                    MEMOIZATION_LOG(info) << "Non-cached access";
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    auto it = m_data.insert(std::make_pair(std::move(key), ret)).first;
+                    for(const auto& o : owners)
+                        m_watched.push_back(std::make_pair(o, it->first));
+                    if(m_watched.size() >= m_sweep_at)
+                        sweep();
+                    return ret;
+                }
+            void sweep(){
+                std::size_t kept = 0;
+                for(std::size_t i = 0; i < m_watched.size(); i++){
+                    if(m_watched[i].first.expired())
+                        m_data.erase(m_watched[i].second);
+                    else
+                        m_watched[kept++] = m_watched[i];
+                }
+                m_watched.erase(m_watched.begin() + kept, m_watched.end());
+                m_sweep_at = 2 * kept + 64;
+            }
+        };
+        template<typename Func, typename... Params>
+            struct table_for{
+                typedef table<decltype(std::declval<const Func&>()(std::declval<Params>()...)),
+                              typename detail::key_type<Params>::type...> type;
+            };
+
+        mutable std::mutex m_mutex; // guards the directory of tables
+        mutable std::map<std::pair<std::string, std::type_index>, std::shared_ptr<void> > m_tables;
+
+        template<typename Table>
+            Table& get_table(const std::string& descr)const{
+                std::lock_guard<std::mutex> lock(m_mutex);
+                std::shared_ptr<void>& t = m_tables[std::make_pair(descr, std::type_index(typeid(Table)))];
+                if(!t)
+                    t = std::make_shared<Table>();
+                return *static_cast<Table*>(t.get());
+            }
+        /// remembers the last table looked up, so that repeated calls skip the directory of tables.
+        class cached_table{
+            void* m_table; // owned by the typed_memory
+            std::type_index m_type;
+          public:
+            cached_table():m_table(NULL), m_type(typeid(void)){}
+            template<typename Table>
+                Table& get(const typed_memory& fc, const std::string& descr){
+                    if(m_type != typeid(Table)){
+                        m_table = &fc.get_table<Table>(descr);
+                        m_type = typeid(Table);
+                    }
+                    return *static_cast<Table*>(m_table);
+                }
+        };
+
+        template<typename Func, typename... Params>
+            auto operator()(const Func& f, Params&&... params) const -> decltype(f(params...)){
+                return (*this)("anonymous", f, std::forward<Params>(params)...);
+            }
+        template<typename Func, typename... Params>
+            auto operator()(const std::string& descr, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                typedef typename table_for<Func, Params&&...>::type table_t;
+                return get_table<table_t>(descr)(f, std::forward<Params>(params)...);
+            }
+        /// unhashable arguments: the table of this descr is keyed by the given seed instead.
+        template<typename Func, typename... Params>
+            auto operator()(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                typedef table<decltype(f(params...)), std::size_t> table_t;
+                return get_table<table_t>(descr)([&](std::size_t){ return f(std::forward<Params>(params)...); }, seed);
+            }
+    };
+
+    template<typename Cache, typename Function>
+    struct memoize{
+        Function m_func; // we require copying the function object here.
+        std::string m_id;
+        Cache& m_fc;
+        memoize(Cache& fc, std::string id, const Function& f)
+            :m_func(f), m_id(id), m_fc(fc){}
+        template<typename... Params>
+        auto operator()(Params&&... args) 
+                -> decltype(std::bind(m_func, args...)()){
+            return m_fc(m_id, m_func, std::forward<Params>(args)...);
+        }
+    };
+
+    /// remembers its typed table, so that calls skip the directory of tables.
+    template<typename Function>
+    struct memoize<typed_memory, Function>{
+        Function m_func;
+        std::string m_id;
+        typed_memory& m_fc;
+        typed_memory::cached_table m_table;
+        memoize(typed_memory& fc, std::string id, const Function& f)
+            :m_func(f), m_id(id), m_fc(fc){}
+        template<typename... Params>
+        auto operator()(Params&&... args)
+                -> decltype(std::bind(m_func, args...)()){
+            typedef typename typed_memory::table_for<Function, Params&&...>::type table_t;
+            return m_table.get<table_t>(m_fc, m_id)(m_func, std::forward<Params>(args)...);
+        }
+    };
+
+    /**
+     * A memoized function whose arguments are reduced to a compact key
+     * before they reach the cache. The key is hashed instead of the
+     * arguments, and compared exactly by typed_memory, so only the parts
+     * of the arguments which influence the result need to be hashable.
+     */
+    template<typename Cache, typename Function, typename Projection>
+    struct projected_memoize : memoize<Cache, Function>{
+        Projection m_key;
+        projected_memoize(Cache& fc, std::string id, const Function& f, const Projection& p)
+            :memoize<Cache, Function>(fc, id, f), m_key(p){}
+        template<typename... Params>
+        auto operator()(Params&&... args)
+                -> decltype(std::bind(this->m_func, args...)()){
+            auto key = m_key(static_cast<const Params&>(args)...);
+            return this->m_fc(this->m_id,
+                    [&](const decltype(key)&){ return this->m_func(std::forward<Params>(args)...); },
+                    key);
+        }
+    };
+
+    namespace detail{
+        template<typename Projection>
+        struct key_projection{
+            Projection projection;
+        };
+    }
+    /// make_memoized(c, id, f, key_by(p)) caches f(args...) under p(args...).
+    template<typename Projection>
+    detail::key_projection<Projection> key_by(Projection p){
+        detail::key_projection<Projection> k = {p};
+        return k;
+    }
+
+    /**
+     * How arguments are rounded before they become part of the key, see
+     * quantize(). Results are computed from the first arguments which
+     * fell into a bucket; values close to a bucket boundary may still end
+     * up in different buckets.
+     */
+    namespace tolerance{
+        /// the argument is used as it is.
+        struct exact{
+            template<typename T>
+                const T& operator()(const T& x)const{ return x; }
+        };
+        /// floating point arguments within eps of each other share a key.
+        struct absolute{
+            double eps;
+            explicit absolute(double e):eps(e){}
+            // the bucket stays a double: no overflow for large x, and NaN and inf remain themselves
+            double operator()(double x)const{ return std::round(x / eps); }
+        };
+        /// only the leading n bits of the mantissa are used.
+        struct bits{
+            int n;
+            explicit bits(int b):n(b){}
+            double operator()(double x)const{
+                if(!std::isfinite(x) || x == 0)
+                    return x;
+                int e;
+                double m = std::frexp(x, &e);
+                return std::ldexp(std::round(std::ldexp(m, n)), e - n);
+            }
+        };
+        /// floating point arguments within a relative tolerance r of each other share a key.
+        struct relative : bits{
+            explicit relative(double r):bits(static_cast<int>(std::ceil(-std::log2(r)))){}
+        };
+    }
+
+    namespace detail{
+        template<typename... Tolerances>
+        struct quantizer{
+            std::tuple<Tolerances...> m_tolerances;
+            template<std::size_t... Is, typename... Args>
+                auto apply(index_sequence<Is...>, const Args&... args)const
+                    -> std::tuple<typename std::decay<decltype(std::get<Is>(m_tolerances)(args))>::type...>{
+                    return std::make_tuple(std::get<Is>(m_tolerances)(args)...);
+                }
+            template<typename... Args>
+                auto operator()(const Args&... args)const
+                    -> decltype(this->apply(make_index_sequence<sizeof...(Args)>(), args...)){
+                    static_assert(sizeof...(Args) == sizeof...(Tolerances), "need one tolerance per argument");
+                    return apply(make_index_sequence<sizeof...(Args)>(), args...);
+                }
+        };
+    }
+    /**
+     * Key projection which rounds each argument according to the
+     * tolerance at its position, e.g.
+     * make_memoized(c, "f", f, quantize(tolerance::absolute(1e-9), tolerance::exact())).
+     */
+    template<typename... Tolerances>
+    detail::key_projection<detail::quantizer<Tolerances...> > quantize(Tolerances... t){
+        detail::quantizer<Tolerances...> q = {std::make_tuple(t...)};
+        return key_by(q);
+    }
+
+    /**
+     * Base of classes whose memoized member functions are keyed by a
+     * version counter. Every object (and copy) gets a process-unique id;
+     * call touch() in every method which changes the state seen by the
+     * memoized members. As ids restart in every process, the persistent
+     * caches reject these keys at compile time.
+     */
+    class versioned{
+        std::uint64_t m_id;
+        std::atomic<std::uint64_t> m_version;
+      protected:
+        versioned():m_id(detail::next_object_id()), m_version(0){}
+        versioned(const versioned&):m_id(detail::next_object_id()), m_version(0){}
+        versioned& operator=(const versioned&){ touch(); return *this; }
+        ~versioned(){}
+      public:
+        void touch(){ ++m_version; }
+        std::uint64_t version()const{ return m_version; }
+        std::uint64_t object_id()const{ return m_id; }
+    };
+
+    namespace detail{
+        // id and version of a versioned object
+        struct object_state{
+            std::uint64_t id, version;
+            friend bool operator==(const object_state& a, const object_state& b){ return a.id == b.id && a.version == b.version; }
+            friend std::size_t hash_value(const object_state& s){ return hash_combine(0, s.id, s.version); }
+        };
+        template<>
+            struct process_local<object_state> : std::true_type{};
+
+        // the part of a key describing the object a member function is called on
+        template<typename T>
+            typename std::enable_if<std::is_base_of<versioned, T>::value, object_state>::type
+            state_key(const T& obj){
+                object_state s = {obj.object_id(), obj.version()};
+                return s;
+            }
+        template<typename T>
+            typename std::enable_if<!std::is_base_of<versioned, T>::value, std::size_t>::type
+            state_key(const T& obj){ return boost::hash<T>()(obj); }
+    }
+
+    /**
+     * A memoized member function, called as m(obj, args...).
+     *
+     * The key includes the state of obj: its id and version if it derives
+     * from versioned (memory caches only), otherwise its hash_value(),
+     * which must then cover everything the member function depends on.
+     * Entries of outdated versions are not removed, limit the cache with
+     * quotas.
+     */
+    template<typename Cache, typename MemFn>
+    struct member_memoize{
+        MemFn m_func;
+        std::string m_id;
+        Cache& m_fc;
+        member_memoize(Cache& fc, std::string id, MemFn f)
+            :m_func(f), m_id(id), m_fc(fc){}
+        template<typename Obj, typename... Params>
+        auto operator()(Obj& obj, Params&&... args)
+                -> typename std::decay<decltype((obj.*(this->m_func))(args...))>::type{
+            auto state = detail::state_key(obj);
+            MemFn f = m_func;
+            return m_fc(m_id,
+                    [&obj, f](const decltype(state)&, const typename std::decay<Params>::type&... a){ return (obj.*f)(a...); },
+                    state, std::forward<Params>(args)...);
+        }
+    };
+
+    /**
+     * A memoized function which also has a batch implementation.
+     *
+     * batch() looks up all arguments, hands the missed ones to the batch
+     * implementation in a single call and stores its results. Elements of
+     * the batch are single arguments or tuples of arguments; the batch
+     * implementation receives a vector of the missed elements and must
+     * return one result per element, in order.
+     *
+     * With coalesce(), scalar misses of concurrent callers are grouped
+     * and evaluated by the batch implementation as well.
+     */
+    template<typename Cache, typename Function, typename Batch>
+    struct batch_memoize : memoize<Cache, Function>{
+        typedef typename detail::batch_element<Batch>::type element_t;
+        typedef detail::batch_args<element_t> element_args_t;
+        typedef typename element_args_t::template result<Function>::type result_t;
+
+        Batch m_batch;
+        std::shared_ptr<detail::coalescer<element_t, result_t> > m_coalescer; // shared by copies
+        batch_memoize(Cache& fc, std::string id, const Function& f, const Batch& b)
+            :memoize<Cache, Function>(fc, id, f), m_batch(b){}
+
+        /**
+         * Misses arriving within window of the first one are evaluated in
+         * a single batch, which is started early when max_count misses are
+         * pending. Configure this before copying the memoized function.
+         */
+        void coalesce(std::chrono::microseconds window, std::size_t max_count){
+            m_coalescer = std::make_shared<detail::coalescer<element_t, result_t> >(window, max_count);
+        }
+
+        template<typename... Params>
+        result_t operator()(Params&&... args){
+            if(!m_coalescer)
+                return memoize<Cache, Function>::operator()(std::forward<Params>(args)...);
+            element_t e = element_args_t::make(std::forward<Params>(args)...);
+            std::size_t seed = element_args_t::hash(detail::hash_combine(0, this->m_id), e);
+            boost::optional<result_t> cached = this->m_fc.template get<result_t>(this->m_id, seed);
+            if(cached)
+                return std::move(*cached);
+            return (*m_coalescer)(e, [this](const std::vector<element_t>& v){ return this->batch(v); });
+        }
+
+        /// for braced lists of elements, from which Arg cannot be deduced.
+        std::vector<result_t> batch(const std::vector<element_t>& args){
+            return this->template batch<element_t>(args);
+        }
+        template<typename Arg>
+        std::vector<typename detail::batch_args<Arg>::template result<Function>::type>
+        batch(const std::vector<Arg>& args){
+            typedef detail::batch_args<Arg> args_t;
+            typedef typename args_t::template result<Function>::type retval_t;
+            std::size_t descr_seed = detail::hash_combine(0, this->m_id);
+            std::vector<std::size_t> seeds(args.size());
+            std::map<std::size_t, std::size_t> pos; // seed -> position in distinct
+            std::vector<std::size_t> distinct, first;
+            for(std::size_t i = 0; i < args.size(); i++){
+                seeds[i] = args_t::hash(descr_seed, args[i]);
+                if(pos.insert(std::make_pair(seeds[i], distinct.size())).second){
+                    distinct.push_back(seeds[i]);
+                    first.push_back(i);
+                }
+            }
+            std::vector<boost::optional<retval_t> > found
+                = this->m_fc.template get_many<retval_t>(this->m_id, distinct);
+
+            std::vector<Arg> missed;
+            std::vector<std::size_t> missed_seeds, missed_pos;
+            for(std::size_t d = 0; d < distinct.size(); d++)
+                if(!found[d]){
+                    missed.push_back(args[first[d]]);
+                    missed_seeds.push_back(distinct[d]);
+                    missed_pos.push_back(d);
+                }
+            if(!missed.empty()){
+                std::vector<retval_t> computed = m_batch(missed);
+                if(computed.size() != missed.size())
+                    throw std::runtime_error("batch function of " + this->m_id + " returned wrong number of results");
+                MEMOIZATION_LOG(info) << "Non-cached batch access, " << missed.size() << " of " << args.size();
+                this->m_fc.put_many(this->m_id, missed_seeds, computed);
+                for(std::size_t j = 0; j < computed.size(); j++)
+                    found[missed_pos[j]].emplace(std::move(computed[j]));
+            }
+            std::vector<retval_t> results;
+            results.reserve(args.size());
+            for(std::size_t i = 0; i < args.size(); i++)
+                results.push_back(*found[pos[seeds[i]]]);
+            return results;
+        }
+    };
+
+    template<class Cache, class Function>
+    struct registry{
+        static std::map<Function, std::pair<std::string, Cache*> > data;
+    };
+    template<class Cache, class Function>
+    std::map<Function, std::pair<std::string, Cache*> >
+    registry<Cache, Function>::data;
+        
+    template<typename Cache, typename Function>
+    memoize<Cache, Function>
+    make_memoized(Cache& fc, const std::string& id, Function f){
+        typedef registry<Cache,Function> reg_t;
+        auto it = reg_t::data.find(f);
+        if(it == reg_t::data.end()){
+            MEMOIZATION_LOG(info) << "registering " << id << " in registry";
+            reg_t::data[f] = std::make_pair(id, &fc);
+        }
+        return memoize<Cache, Function>(fc, id, f);
+    }
+
+    /// memoize a function which has a scalar implementation f and a batch implementation b.
+    template<typename Cache, typename Function, typename Batch>
+    batch_memoize<Cache, Function, Batch>
+    make_memoized(Cache& fc, const std::string& id, Function f, Batch b){
+        make_memoized(fc, id, f);
+        return batch_memoize<Cache, Function, Batch>(fc, id, f, b);
+    }
+
+    /// memoize a function whose results depend only on the key computed from its arguments.
+    template<typename Cache, typename Function, typename Projection>
+    projected_memoize<Cache, Function, Projection>
+    make_memoized(Cache& fc, const std::string& id, Function f, detail::key_projection<Projection> k){
+        make_memoized(fc, id, f);
+        return projected_memoize<Cache, Function, Projection>(fc, id, f, k.projection);
+    }
+
+    /// memoize a member function, see member_memoize.
+    template<typename Cache, typename R, typename C, typename... A>
+    member_memoize<Cache, R (C::*)(A...) const>
+    make_memoized(Cache& fc, const std::string& id, R (C::*f)(A...) const){
+        return member_memoize<Cache, R (C::*)(A...) const>(fc, id, f);
+    }
+    template<typename Cache, typename R, typename C, typename... A>
+    member_memoize<Cache, R (C::*)(A...)>
+    make_memoized(Cache& fc, const std::string& id, R (C::*f)(A...)){
+        return member_memoize<Cache, R (C::*)(A...)>(fc, id, f);
+    }
+
+    template<typename Cache, typename Function, typename...Args>
+    auto
+    memoized(Function f, Args&&... args) -> decltype(std::bind(f, args...)()){
+        typedef registry<Cache,Function> reg_t;
+        auto it = reg_t::data.find(f);
+        if(it == reg_t::data.end())
+            throw std::runtime_error("memoize function is not registered with a cache");
+        std::string id;
+        Cache* fc;
+        std::tie(id,fc) = it->second;
+        return memoize<Cache, Function>(*fc, id, f)(std::forward<Args>(args)...);
+    }
+
+}
+#endif /* __MEMOIZATION_CORE_HPP_295387__ */
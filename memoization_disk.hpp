@@ -0,0 +1,424 @@
+/**
+ * The disk cache. Results of the types instantiated in memoization.cpp
+ * (see below) can be cached with this header alone; for other types,
+ * include memoization_disk_impl.hpp (or memoization.hpp), which pulls in
+ * Boost.Serialization.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_DISK_HPP_295387__
+#     define __MEMOIZATION_DISK_HPP_295387__
+#include <set>
+#include <map>
+#include <deque>
+#include <iosfwd>
+#include "memoization_core.hpp"
+#include "memoization_io.hpp"
+
+namespace memoization{
+    /**
+     * Identifies the running executable: its GNU build-id, or, if it was
+     * linked without one, the size and modification time of the file.
+     */
+    std::string build_id();
+
+    namespace detail{
+        std::string current_directory();
+    }
+
+    struct disk;
+    namespace detail{
+        /**
+         * Queue of serialized entries which a thread of its own writes to
+         * the disk cache, at most at the rates of its token buckets.
+         */
+        class write_behind{
+          public:
+            struct entry{
+                std::string descr, fn;
+                aligned_buffer data;
+                std::uint64_t digest;
+                bool cancelled;
+            };
+            token_bucket m_bytes, m_ops;
+          private:
+            const disk& m_disk;
+            std::size_t m_max_queued, m_queued;
+            std::mutex m_mutex;
+            std::condition_variable m_wakeup, m_idle;
+            std::deque<std::shared_ptr<entry> > m_queue;
+            std::map<std::string, std::shared_ptr<entry> > m_pending; // by file name, until written
+            std::shared_ptr<entry> m_current; // taken from the queue, waiting for tokens or being written
+            bool m_writing;                   // m_current is being written, it can no longer be cancelled
+            std::condition_variable m_written;
+            bool m_stop;
+            std::thread m_thread;
+            void work();
+          public:
+            write_behind(const disk& d, double bytes_per_second, double ops_per_second, std::size_t max_queued);
+            /// writes everything queued, then stops.
+            ~write_behind();
+            /// false if the queue is full and e was dropped.
+            bool push(std::shared_ptr<entry> e);
+            /// the data of a queued entry for fn.
+            std::shared_ptr<const entry> pending(const std::string& fn);
+            /// do not write the queued entries for fn. Waits for a write of fn which has already begun.
+            void cancel(const std::string& fn);
+            /// waits until the queue is empty.
+            void flush();
+        };
+    }
+
+    struct disk{
+        std::string m_path;
+        std::string m_dir; // of the current generation
+        std::vector<std::string> m_prior; // older generations, newest first
+        std::set<std::string> m_stable;
+        mutable detail::quota_ledger<std::string> m_ledger;
+        mutable std::mutex m_mutex; // guards the ledger and m_entry_size
+        mutable std::map<std::string, std::size_t> m_entry_size; // of the last entry stored per descr
+        bool m_accounting;
+        std::shared_ptr<io::engine> m_io;
+        std::size_t m_direct_threshold;
+        bool m_sync;
+        std::unique_ptr<detail::write_behind> m_writer; // declared last, written out first
+        disk(std::string path = detail::current_directory());
+
+        /**
+         * Keep entries in a subdirectory for generation g, so that results
+         * of other generations (e.g. builds, see use_build_id()) are not
+         * seen. Call before any other configuration.
+         */
+        void set_generation(const std::string& g);
+        /// one generation per build of the executable, cached results do not survive code changes.
+        void use_build_id(){ set_generation(build_id()); }
+        /**
+         * Results of descr do not depend on the build: they are still
+         * found in older generations and carried over to the current one.
+         */
+        void mark_stable(const std::string& descr){ m_stable.insert(descr); }
+        /// delete all generations but the current one. Stable entries carried over are kept.
+        void remove_old_generations();
+
+        /// limit the whole cache directory. Existing files are accounted for on the first call.
+        void set_capacity(const quota& q){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            start_accounting();
+            m_ledger.set_capacity(q);
+        }
+        /// limit the files of one descr. Enforced when the descr next stores a result.
+        void set_quota(const std::string& descr, const quota& q){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            start_accounting();
+            m_ledger.set_quota(descr, q);
+        }
+        /// perform the file I/O of batch lookups through e, e.g. io::make_engine().
+        void set_io_engine(std::shared_ptr<io::engine> e){ m_io = e; }
+        /**
+         * Read and write entries of at least threshold bytes with O_DIRECT,
+         * so that large, cold entries do not push other data out of the
+         * page cache. Zero turns this off.
+         */
+        void set_direct_io(std::size_t threshold){ m_direct_threshold = threshold; }
+        /// fsync entries before moving them into place, so that they survive a crash.
+        void set_sync(bool sync){ m_sync = sync; }
+        /**
+         * Write (and evict) entries in the background, at most at the given
+         * rates, so that the cache does not starve other programs of I/O.
+         * Lookups never wait for the limits; entries waiting to be written
+         * are found in the queue. If more than max_queued bytes are waiting,
+         * further results are not stored. Zero rates turn this off.
+         */
+        void set_write_limit(double bytes_per_second, double ops_per_second = 0, std::size_t max_queued = 256 << 20);
+        /// wait until all entries queued by a write limit are written.
+        void flush();
+        usage used()const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_ledger.used();
+        }
+        usage used(const std::string& descr)const{
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_ledger.used(descr);
+        }
+
+        template<typename Func, typename... Params>
+            auto operator()(const Func& f, Params&&... params) const -> decltype(f(params...)){
+                return (*this)("anonymous", f, std::forward<Params>(params)...);
+            }
+        template<typename Func, typename... Params>
+            auto operator()(const std::string& descr, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                detail::assert_persistent_keys<Params...>();
+                std::size_t seed = detail::hash_combine(0, descr, params...);
+                return (*this)(descr, seed, f, std::forward<Params>(params)...);
+            }
+        template<typename Func, typename... Params>
+            auto operator()(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                typedef decltype(f(params...)) retval_t;
+                boost::optional<retval_t> cached = get<retval_t>(descr, seed);
+                if(cached)
+                    return std::move(*cached);
+                retval_t ret = f(std::forward<Params>(params)...);
+                MEMOIZATION_LOG(info) << "Non-cached access, file "<<filename(descr, seed);
+                put(descr, seed, ret);
+                return ret;
+            }
+
+        // defined in memoization_disk_impl.hpp
+        template<typename R>
+            boost::optional<R> get(const std::string& descr, std::size_t seed)const;
+        template<typename R>
+            std::vector<boost::optional<R> > get_many(const std::string& descr, const std::vector<std::size_t>& seeds)const;
+        template<typename R>
+            void put(const std::string& descr, std::size_t seed, const R& value)const;
+        template<typename R>
+            void put_many(const std::string& descr, const std::vector<std::size_t>& seeds, const std::vector<R>& values)const;
+
+        std::string filename(const std::string& descr, std::size_t seed)const;
+        /// remove an entry.
+        void erase(const std::string& descr, std::size_t seed)const;
+
+      private:
+        template<typename R>
+            boost::optional<R> load(std::istream& is, const std::string& fn)const;
+        template<typename R>
+            static void save(std::ostream& os, const R& value);
+        // links the entry of a stable descr from the newest older generation which has it
+        void carry_over(const std::string& descr, std::size_t seed)const;
+        static std::string temporary(const std::string& fn);
+        // serialized size of the last entry of descr, zero if none, to reserve buffers up front
+        std::size_t expected_size(const std::string& descr)const;
+        void record_size(const std::string& descr, std::size_t bytes)const;
+        /**
+         * Whether fn already holds these n bytes, judged by the digest
+         * stored with it or else by its contents. Counts as a use of fn.
+         */
+        bool unchanged(const std::string& fn, const char* data, std::size_t n, std::uint64_t digest)const;
+        // moves a completely written file into place, with its digest, and accounts for it
+        void commit(const std::string& descr, const std::string& tmp, const std::string& fn, std::uint64_t digest)const;
+        // writes a serialized entry now, or queues it under a write limit
+        void store(const std::string& descr, const std::string& fn, detail::aligned_buffer& data, std::uint64_t digest)const;
+        friend class detail::write_behind;
+        void write_now(const std::string& descr, const std::string& fn, const detail::aligned_buffer& data, std::uint64_t digest)const;
+        // registers the files already in the cache directory, oldest first.
+        void start_accounting();
+    };
+
+    /**
+     * Handed to a checkpointed function, see make_checkpointed(): holds
+     * the state saved by an interrupted earlier call, and saves new state.
+     */
+    template<typename State>
+    class checkpoint{
+        const disk& m_fc;
+        std::string m_descr;
+        std::size_t m_seed;
+        std::chrono::steady_clock::duration m_interval;
+        std::chrono::steady_clock::time_point m_last;
+        boost::optional<State> m_restored;
+      public:
+        checkpoint(const disk& fc, const std::string& descr, std::size_t seed, std::chrono::steady_clock::duration interval)
+            :m_fc(fc), m_descr(descr), m_seed(seed), m_interval(interval), m_last(std::chrono::steady_clock::now()),
+             m_restored(fc.get<State>(descr, seed)){}
+        /// the latest state saved before the computation was interrupted, if any.
+        boost::optional<State>& restored(){ return m_restored; }
+        /// whether the interval has passed since the last save.
+        bool due()const{ return std::chrono::steady_clock::now() - m_last >= m_interval; }
+        void save(const State& s){
+            m_fc.put(m_descr, m_seed, s);
+            m_last = std::chrono::steady_clock::now();
+        }
+        /// save s if due().
+        void update(const State& s){
+            if(due())
+                save(s);
+        }
+    };
+
+    /**
+     * A long running memoized function f(checkpoint<State>&, args...),
+     * which saves intermediate state through the checkpoint so that, if
+     * the process dies, the next call with the same arguments resumes
+     * from there. The checkpoint is removed when the result is stored.
+     */
+    template<typename State, typename Function>
+    struct checkpointed_memoize{
+        Function m_func;
+        std::string m_id;
+        disk& m_fc;
+        std::chrono::steady_clock::duration m_interval;
+        checkpointed_memoize(disk& fc, std::string id, const Function& f, std::chrono::steady_clock::duration interval)
+            :m_func(f), m_id(id), m_fc(fc), m_interval(interval){}
+        template<typename... Params>
+        auto operator()(Params&&... args)
+                -> typename std::decay<decltype(m_func(std::declval<checkpoint<State>&>(), args...))>::type{
+            typedef typename std::decay<decltype(m_func(std::declval<checkpoint<State>&>(), args...))>::type retval_t;
+            detail::assert_persistent_keys<Params...>();
+            std::size_t seed = detail::hash_combine(0, m_id, args...);
+            boost::optional<retval_t> cached = m_fc.get<retval_t>(m_id, seed);
+            if(cached)
+                return std::move(*cached);
+            std::string cp_id = m_id + ".checkpoint";
+            checkpoint<State> cp(m_fc, cp_id, seed, m_interval);
+            if(cp.restored()){
+                MEMOIZATION_LOG(info) << "Resuming " << m_id << " from checkpoint";
+            }
+            retval_t ret = m_func(cp, std::forward<Params>(args)...);
+            m_fc.put(m_id, seed, ret);
+            m_fc.erase(cp_id, seed);
+            return ret;
+        }
+    };
+
+    /// memoize f(checkpoint<State>&, args...), which may save its state at most every interval.
+    template<typename State, typename Function>
+    checkpointed_memoize<State, Function>
+    make_checkpointed(disk& fc, const std::string& id, Function f,
+            std::chrono::steady_clock::duration interval = std::chrono::seconds(60)){
+        return checkpointed_memoize<State, Function>(fc, id, f, interval);
+    }
+
+    namespace detail{
+        /**
+         * First-order model of which key follows which: counts transitions
+         * between consecutive keys and predicts the most frequent
+         * successor. Forgets everything when it knows too many keys.
+         */
+        class transitions{
+            std::unordered_map<std::size_t, std::unordered_map<std::size_t, unsigned> > m_next;
+            boost::optional<std::size_t> m_last;
+            std::size_t m_max_keys;
+          public:
+            explicit transitions(std::size_t max_keys = 1 << 16):m_max_keys(max_keys){}
+            /// records k as the successor of the previous key and predicts the successor of k.
+            boost::optional<std::size_t> visit(std::size_t k, unsigned min_count){
+                if(m_last && *m_last != k){
+                    if(m_next.size() >= m_max_keys)
+                        m_next.clear();
+                    m_next[*m_last][k]++;
+                }
+                m_last = k;
+                auto it = m_next.find(k);
+                if(it == m_next.end())
+                    return boost::none;
+                unsigned total = 0;
+                auto best = it->second.end();
+                for(auto n = it->second.begin(); n != it->second.end(); ++n){
+                    total += n->second;
+                    if(best == it->second.end() || n->second > best->second)
+                        best = n;
+                }
+                // only confident predictions: seen often, and more often than all others together
+                if(best->second < min_count || 2 * best->second <= total)
+                    return boost::none;
+                return best->first;
+            }
+        };
+    }
+
+    /**
+     * The disk cache with a memory cache in front of it, which learns
+     * which key usually follows which (per descr) and loads the likely
+     * next entry from disk into memory in the background, before it is
+     * asked for.
+     */
+    class prefetching : public detail::cache_base<prefetching, true>{
+        const disk& m_disk;
+        memory m_memory;
+        unsigned m_min_count;
+        mutable std::mutex m_mutex;
+        mutable std::condition_variable m_idle;
+        mutable std::map<std::string, detail::transitions> m_models;
+        mutable std::set<std::size_t> m_loading;
+        mutable std::size_t m_prefetched;
+        mutable detail::thread_pool m_pool; // declared last, finishes loading first
+
+        template<typename R>
+            void predict(const std::string& descr, std::size_t seed)const{
+                std::lock_guard<std::mutex> lock(m_mutex);
+                boost::optional<std::size_t> next = m_models[descr].visit(seed, m_min_count);
+                if(!next || !m_loading.insert(*next).second)
+                    return;
+                std::size_t n = *next;
+                m_pool.post([this, descr, n](){
+                    bool loaded = false;
+                    if(!m_memory.get<R>(descr, n)){
+                        boost::optional<R> v = m_disk.get<R>(descr, n);
+                        if(v){
+                            m_memory.put(descr, n, *v);
+                            loaded = true;
+                        }
+                    }
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_loading.erase(n);
+                    m_prefetched += loaded;
+                    if(m_loading.empty())
+                        m_idle.notify_all();
+                });
+            }
+      public:
+        /**
+         * Predictions need a transition seen min_count times, which is
+         * more than half of the transitions seen from that key.
+         */
+        explicit prefetching(const disk& d, unsigned min_count = 2, std::size_t threads = 2)
+            :m_disk(d), m_min_count(min_count), m_prefetched(0), m_pool(threads){}
+        /// the memory cache in front of the disk, e.g. to set its capacity.
+        memory& front(){ return m_memory; }
+        /// number of entries loaded ahead of use.
+        std::size_t prefetched(){
+            std::lock_guard<std::mutex> lock(m_mutex);
+            return m_prefetched;
+        }
+        /// waits until no entries are being loaded.
+        void wait(){
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this]{ return m_loading.empty(); });
+        }
+
+        using detail::cache_base<prefetching, true>::operator();
+        /// as for the disk cache, the seed is used as given.
+        template<typename Func, typename... Params>
+            auto operator()(const std::string& descr, std::size_t seed, const Func& f, Params&&... params) const -> decltype(f(params...)){
+                return lookup(descr, seed, f, std::forward<Params>(params)...);
+            }
+
+        template<typename R>
+            boost::optional<R> get(const std::string& descr, std::size_t seed)const{
+                boost::optional<R> ret = m_memory.get<R>(descr, seed);
+                if(!ret){
+                    ret = m_disk.get<R>(descr, seed);
+                    if(ret)
+                        m_memory.put(descr, seed, *ret);
+                }
+                predict<R>(descr, seed);
+                return ret;
+            }
+        template<typename R>
+            void put(const std::string& descr, std::size_t seed, const R& value)const{
+                m_disk.put(descr, seed, value);
+                m_memory.put(descr, seed, value);
+            }
+    };
+
+#define MEMOIZATION_DISK_INSTANTIATION(EXTERN, R) \
+    EXTERN template boost::optional<R> disk::get<R>(const std::string&, std::size_t)const; \
+    EXTERN template std::vector<boost::optional<R> > disk::get_many<R>(const std::string&, const std::vector<std::size_t>&)const; \
+    EXTERN template void disk::put<R>(const std::string&, std::size_t, const R&)const; \
+    EXTERN template void disk::put_many<R>(const std::string&, const std::vector<std::size_t>&, const std::vector<R>&)const;
+#define MEMOIZATION_DISK_INSTANTIATIONS(EXTERN) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, bool) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, int) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, long) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, unsigned) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, float) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, double) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, std::string) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, std::vector<int>) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, std::vector<long>) \
+    MEMOIZATION_DISK_INSTANTIATION(EXTERN, std::vector<double>)
+
+    // compiled into memoization.cpp
+    MEMOIZATION_DISK_INSTANTIATIONS(extern)
+}
+#endif /* __MEMOIZATION_DISK_HPP_295387__ */
@@ -0,0 +1,168 @@
+/**
+ * Serialization of results for the disk cache, needed for caching
+ * results of types which are not instantiated in memoization.cpp.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_DISK_IMPL_HPP_295387__
+#     define __MEMOIZATION_DISK_IMPL_HPP_295387__
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <type_traits>
+#include <sys/stat.h>
+#include <boost/archive/binary_iarchive.hpp>
+#include <boost/archive/binary_oarchive.hpp>
+#include <boost/serialization/serialization.hpp>
+#include <boost/serialization/version.hpp>
+#include <boost/iostreams/device/array.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/stream.hpp>
+#include "memoization_disk.hpp"
+
+namespace memoization{
+    namespace detail{
+        /**
+         * Loads a T from an archive without requiring a default
+         * constructor: as boost does for pointers, the object is created in
+         * place by load_construct_data (which defaults to T()) and then
+         * loaded. The result is moved out.
+         */
+        template<typename T, typename Archive>
+            T load_constructed(Archive& ar){
+                typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+                T* t = reinterpret_cast<T*>(&storage);
+                boost::serialization::load_construct_data_adl(ar, t, boost::serialization::version<T>::value);
+                struct destroy{
+                    T* t;
+                    ~destroy(){ t->~T(); }
+                } guard = {t};
+                ar >> *t;
+                return std::move(*t);
+            }
+        /// counterpart of load_constructed, writes save_construct_data before the object.
+        template<typename T, typename Archive>
+            void save_constructed(Archive& ar, const T& t){
+                boost::serialization::save_construct_data_adl(ar, &t, boost::serialization::version<T>::value);
+                ar << t;
+            }
+    }
+
+    template<typename R>
+        boost::optional<R> disk::get(const std::string& descr, std::size_t seed)const{
+            std::string fn = filename(descr, seed);
+            if(m_writer){
+                std::shared_ptr<const detail::write_behind::entry> e = m_writer->pending(fn);
+                if(e){
+                    boost::iostreams::stream<boost::iostreams::array_source> is(e->data.data(), e->data.size());
+                    return load<R>(is, fn);
+                }
+            }
+            carry_over(descr, seed);
+            struct stat st;
+            if(m_direct_threshold && ::stat(fn.c_str(), &st) == 0 && std::size_t(st.st_size) >= m_direct_threshold){
+                detail::aligned_buffer buf;
+                if(!detail::read_direct(fn, buf))
+                    return boost::none;
+                boost::iostreams::stream<boost::iostreams::array_source> is(buf.data(), buf.size());
+                return load<R>(is, fn);
+            }
+            std::ifstream ifs(fn);
+            if(!ifs)
+                return boost::none;
+            return load<R>(ifs, fn);
+        }
+    template<typename R>
+        std::vector<boost::optional<R> > disk::get_many(const std::string& descr, const std::vector<std::size_t>& seeds)const{
+            std::vector<boost::optional<R> > ret(seeds.size());
+            if(!m_io || m_writer){
+                for(std::size_t i = 0; i < seeds.size(); i++)
+                    ret[i] = get<R>(descr, seeds[i]);
+                return ret;
+            }
+            std::vector<io::request> reqs;
+            for(std::size_t seed : seeds){
+                carry_over(descr, seed);
+                reqs.push_back(io::request(filename(descr, seed)));
+            }
+            m_io->read(reqs);
+            for(std::size_t i = 0; i < reqs.size(); i++){
+                if(!reqs[i].ok)
+                    continue;
+                boost::iostreams::stream<boost::iostreams::array_source> is(reqs[i].data.data(), reqs[i].data.size());
+                ret[i] = load<R>(is, reqs[i].path);
+            }
+            return ret;
+        }
+    template<typename R>
+        void disk::put(const std::string& descr, std::size_t seed, const R& value)const{
+            std::string fn = filename(descr, seed);
+            detail::aligned_buffer buf;
+            // results of a function tend to be of similar size, so large ones are not copied while growing
+            buf.reserve(expected_size(descr));
+            {
+                boost::iostreams::stream<boost::iostreams::back_insert_device<detail::aligned_buffer> > os(buf);
+                save(os, value);
+            }
+            record_size(descr, buf.size());
+            if(buf.capacity() > 2 * buf.size())
+                buf.shrink_to_fit(); // may be queued for a while
+            store(descr, fn, buf, detail::digest(buf.data(), buf.size()));
+        }
+    template<typename R>
+        void disk::put_many(const std::string& descr, const std::vector<std::size_t>& seeds, const std::vector<R>& values)const{
+            if(!m_io || m_writer){
+                for(std::size_t i = 0; i < seeds.size(); i++)
+                    put(descr, seeds[i], values[i]);
+                return;
+            }
+            std::vector<io::request> reqs;
+            std::vector<std::string> fns;
+            std::vector<std::uint64_t> digests;
+            for(std::size_t i = 0; i < seeds.size(); i++){
+                std::ostringstream os;
+                save(os, values[i]);
+                std::string data = os.str();
+                std::string fn = filename(descr, seeds[i]);
+                std::uint64_t digest = detail::digest(data.data(), data.size());
+                if(unchanged(fn, data.data(), data.size(), digest))
+                    continue;
+                reqs.push_back(io::request(temporary(fn), data));
+                fns.push_back(fn);
+                digests.push_back(digest);
+            }
+            m_io->write(reqs);
+            for(std::size_t i = 0; i < reqs.size(); i++){
+                if(reqs[i].ok)
+                    commit(descr, reqs[i].path, fns[i], digests[i]);
+                else{
+                    MEMOIZATION_LOG(warning) << "Could not write cache file "<<reqs[i].path;
+                    std::remove(reqs[i].path.c_str());
+                }
+            }
+        }
+
+    template<typename R>
+        boost::optional<R> disk::load(std::istream& is, const std::string& fn)const{
+            boost::optional<R> ret;
+            try{
+                boost::archive::binary_iarchive ia(is);
+                ret.emplace(detail::load_constructed<R>(ia));
+            }catch(const boost::archive::archive_exception& e){
+                MEMOIZATION_LOG(warning) << "Ignoring unreadable cache file "<<fn<<": "<<e.what();
+                return boost::none;
+            }
+            MEMOIZATION_LOG(info) << "Cached access from file "<<fn;
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if(m_accounting)
+                m_ledger.touch(fn);
+            return ret;
+        }
+    template<typename R>
+        void disk::save(std::ostream& os, const R& value){
+            boost::archive::binary_oarchive oa(os);
+            detail::save_constructed(oa, value);
+        }
+}
+#endif /* __MEMOIZATION_DISK_IMPL_HPP_295387__ */
@@ -0,0 +1,109 @@
+/**
+ * Memoization of functions of a range, f(begin, end), whose results for
+ * adjacent ranges can be combined. Builds on typed_memory.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_INTERVAL_HPP_295387__
+#     define __MEMOIZATION_INTERVAL_HPP_295387__
+#include "memoization_core.hpp"
+
+namespace memoization{
+    /**
+     * A memoized function of a half-open range, f(begin, end), whose
+     * result for a range can be combined from the results of adjacent
+     * sub-ranges: f(a, c) == combine(f(a, b), f(b, c)).
+     *
+     * Results of computed ranges are kept in a typed_memory. A query is
+     * answered from cached ranges which lie within it, and f is only
+     * called for the gaps between them.
+     */
+    template<typename Function, typename Combine>
+    struct interval_memoize{
+        template<typename Index, typename R>
+        struct table{
+            std::mutex m_mutex;
+            std::map<Index, std::map<Index, R> > m_pieces; // begin -> end -> result
+        };
+
+        Function m_func;
+        Combine m_combine;
+        std::string m_id;
+        typed_memory& m_fc;
+        typed_memory::cached_table m_table;
+        interval_memoize(typed_memory& fc, std::string id, const Function& f, const Combine& c)
+            :m_func(f), m_combine(c), m_id(id), m_fc(fc){}
+
+        template<typename Index>
+        auto operator()(Index begin, Index end)
+                -> typename std::decay<decltype(m_func(begin, end))>::type{
+            typedef typename std::decay<decltype(m_func(begin, end))>::type retval_t;
+            typedef table<Index, retval_t> table_t;
+            if(!(begin < end))
+                return m_func(begin, end);
+            table_t& t = m_table.get<table_t>(m_fc, m_id);
+
+            // cover [begin, end) by cached pieces, leaving gaps where there are none
+            std::vector<std::pair<Index, Index> > plan;
+            std::vector<boost::optional<retval_t> > parts;
+            {
+                std::lock_guard<std::mutex> lock(t.m_mutex);
+                Index p = begin;
+                while(p < end){
+                    auto it = t.m_pieces.find(p);
+                    if(it != t.m_pieces.end()){
+                        // the longest piece starting here which fits
+                        auto e = it->second.upper_bound(end);
+                        if(e != it->second.begin()){
+                            --e;
+                            plan.push_back(std::make_pair(p, e->first));
+                            parts.push_back(e->second);
+                            p = e->first;
+                            continue;
+                        }
+                    }
+                    // a gap until the next piece which fits
+                    Index q = end;
+                    for(auto n = t.m_pieces.upper_bound(p); n != t.m_pieces.end() && n->first < end; ++n)
+                        if(!(end < n->second.begin()->first)){
+                            q = n->first;
+                            break;
+                        }
+                    plan.push_back(std::make_pair(p, q));
+                    parts.push_back(boost::none);
+                    p = q;
+                }
+            }
+            if(plan.size() == 1 && parts[0]){
+                MEMOIZATION_LOG(info) << "Cached access from intervals";
+                return std::move(*parts[0]);
+            }
+
+            std::size_t n_computed = 0;
+            for(std::size_t i = 0; i < plan.size(); i++)
+                if(!parts[i]){
+                    parts[i].emplace(m_func(plan[i].first, plan[i].second));
+                    n_computed++;
+                }
+            MEMOIZATION_LOG(info) << "Interval access, computed " << n_computed << " of " << plan.size() << " pieces";
+            retval_t ret = *parts[0];
+            for(std::size_t i = 1; i < parts.size(); i++)
+                ret = m_combine(ret, *parts[i]);
+
+            std::lock_guard<std::mutex> lock(t.m_mutex);
+            for(std::size_t i = 0; i < plan.size(); i++)
+                t.m_pieces[plan[i].first].insert(std::make_pair(plan[i].second, *parts[i]));
+            t.m_pieces[begin][end] = ret;
+            return ret;
+        }
+    };
+
+    /// memoize f(begin, end) as ranges which combine(f(a, b), f(b, c)) joins, see interval_memoize.
+    template<typename Function, typename Combine>
+    interval_memoize<Function, Combine>
+    make_interval_memoized(typed_memory& fc, const std::string& id, Function f, Combine combine){
+        return interval_memoize<Function, Combine>(fc, id, f, combine);
+    }
+}
+#endif /* __MEMOIZATION_INTERVAL_HPP_295387__ */
@@ -0,0 +1,158 @@
+/**
+ * File I/O for the disk cache: engines which read and write the files of
+ * many cache entries at once, and helpers for O_DIRECT. Implemented in
+ * memoization.cpp.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_IO_HPP_295387__
+#     define __MEMOIZATION_IO_HPP_295387__
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <functional>
+#include <new>
+#include <utility>
+#include <cstdlib>
+#include <cstdint>
+
+namespace memoization{
+    /**
+     * Engines for the file I/O of many cache entries at once.
+     *
+     * The disk cache uses an engine, if it has one, for batch lookups:
+     * all files of a batch are opened, read or written concurrently
+     * instead of one after the other.
+     */
+    namespace io{
+        /// a file to be read completely, or to be written with data.
+        struct request{
+            std::string path;
+            std::string data;
+            bool ok;
+            explicit request(const std::string& p = "", const std::string& d = "")
+                :path(p), data(d), ok(false){}
+        };
+
+        struct engine{
+            virtual ~engine(){}
+            /// reads the files of all requests, ok is false for missing or unreadable files.
+            virtual void read(std::vector<request>& reqs) = 0;
+            /// creates or truncates the files of all requests and writes their data.
+            virtual void write(std::vector<request>& reqs) = 0;
+        };
+    }
+
+    namespace detail{
+        /// a fixed number of threads, at least one, working off a queue of tasks.
+        class thread_pool{
+            std::mutex m_mutex;
+            std::condition_variable m_wakeup;
+            std::deque<std::function<void()> > m_tasks;
+            std::vector<std::thread> m_threads;
+            bool m_stop;
+          public:
+            explicit thread_pool(std::size_t n_threads);
+            ~thread_pool();
+            void post(std::function<void()> task);
+            /// runs f(0), ..., f(n-1) on the pool and waits for all of them.
+            void run_all(std::size_t n, const std::function<void(std::size_t)>& f);
+          private:
+            void work();
+        };
+
+        /// 64 bit FNV-1a hash of n bytes, identifies the contents of cache files.
+        std::uint64_t digest(const char* data, std::size_t n);
+
+        bool read_file(io::request& r);
+        bool write_file(const io::request& r);
+
+        // buffers for O_DIRECT, which requires block aligned memory, offsets and lengths
+        const std::size_t direct_io_alignment = 4096;
+        template<typename T>
+        struct aligned_allocator{
+            typedef T value_type;
+            aligned_allocator(){}
+            template<typename U> aligned_allocator(const aligned_allocator<U>&){}
+            T* allocate(std::size_t n){
+                void* p = NULL;
+                if(::posix_memalign(&p, direct_io_alignment, n * sizeof(T)) != 0)
+                    throw std::bad_alloc();
+                return static_cast<T*>(p);
+            }
+            void deallocate(T* p, std::size_t){ ::free(p); }
+            // default-initializes, so that resize() does not zero what is read over anyway
+            template<typename U> void construct(U* p){ ::new(static_cast<void*>(p)) U; }
+            template<typename U, typename... Args> void construct(U* p, Args&&... args){
+                ::new(static_cast<void*>(p)) U(std::forward<Args>(args)...);
+            }
+            template<typename U> bool operator==(const aligned_allocator<U>&)const{ return true; }
+            template<typename U> bool operator!=(const aligned_allocator<U>&)const{ return false; }
+        };
+        typedef std::vector<char, aligned_allocator<char> > aligned_buffer;
+
+        /**
+         * Reads a whole file, bypassing the page cache where possible. If
+         * the file system does not support O_DIRECT, pages are dropped from
+         * the page cache after reading.
+         */
+        bool read_direct(const std::string& path, aligned_buffer& buf);
+        /// writes buf to a file, bypassing the page cache where possible.
+        bool write_direct(const std::string& path, const aligned_buffer& buf);
+
+        /**
+         * Limits a rate, e.g. of bytes or operations per second, allowing
+         * bursts of up to one second worth. A zero rate is unlimited.
+         */
+        class token_bucket{
+            std::mutex m_mutex;
+            double m_rate;
+            double m_tokens;
+            std::chrono::steady_clock::time_point m_last;
+          public:
+            explicit token_bucket(double rate = 0);
+            /// waits until n tokens are available and takes them.
+            void take(double n);
+        };
+
+        class uring;
+    }
+
+    namespace io{
+        /// blocking reads and writes, spread over a pool of threads.
+        class thread_pool_engine : public engine{
+            detail::thread_pool m_pool;
+          public:
+            explicit thread_pool_engine(std::size_t n_threads = 8);
+            void read(std::vector<request>& reqs);
+            void write(std::vector<request>& reqs);
+        };
+
+        /**
+         * Submits the opens, reads and writes of all requests through an
+         * io_uring, keeping up to depth operations in flight.
+         *
+         * Talks to the kernel directly, so liburing is not required. The
+         * constructor throws std::system_error if io_uring or one of the
+         * required operations is not supported.
+         */
+        class uring_engine : public engine{
+            std::unique_ptr<detail::uring> m_ring;
+          public:
+            explicit uring_engine(unsigned depth = 64);
+            ~uring_engine();
+            void read(std::vector<request>& reqs);
+            void write(std::vector<request>& reqs);
+        };
+
+        /// an io_uring engine where the kernel supports it, otherwise a pool of threads.
+        std::shared_ptr<engine> make_engine(unsigned depth = 64);
+    }
+}
+#endif /* __MEMOIZATION_IO_HPP_295387__ */
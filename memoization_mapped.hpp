@@ -0,0 +1,115 @@
+/**
+ * A cache which lives in a memory mapped file, for results of trivially
+ * copyable types (and vectors and strings of them). Link with
+ * memoization.cpp.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_MAPPED_HPP_295387__
+#     define __MEMOIZATION_MAPPED_HPP_295387__
+#include <cstring>
+#include "memoization_core.hpp"
+
+namespace memoization{
+    namespace detail{
+        // how a result is laid out in the arena
+        template<typename R, typename Enable = void>
+            struct mapped_layout{
+                static_assert(std::is_trivially_copyable<R>::value,
+                        "mapped_memory stores trivially copyable types, and vectors and strings of them");
+                static_assert(!std::is_pointer<R>::value && !std::is_member_pointer<R>::value,
+                        "mapped_memory cannot store pointers, their addresses are meaningless after a restart");
+                static std::size_t bytes(const R&){ return sizeof(R); }
+                static const char* data(const R& r){ return reinterpret_cast<const char*>(&r); }
+                static boost::optional<R> load(const char* p, std::size_t n){
+                    if(n != sizeof(R))
+                        return boost::none;
+                    R r;
+                    std::memcpy(&r, p, n);
+                    return r;
+                }
+            };
+        template<typename R>
+            struct mapped_layout<R, typename std::enable_if<flat_array<R>::value>::type>{
+                typedef typename flat_array<R>::element_type element_t;
+                static_assert(!std::is_pointer<element_t>::value && !std::is_member_pointer<element_t>::value,
+                        "mapped_memory cannot store pointers, their addresses are meaningless after a restart");
+                static std::size_t bytes(const R& r){ return r.size() * sizeof(element_t); }
+                static const char* data(const R& r){ return reinterpret_cast<const char*>(r.data()); }
+                static boost::optional<R> load(const char* p, std::size_t n){
+                    if(n % sizeof(element_t))
+                        return boost::none;
+                    const element_t* e = reinterpret_cast<const element_t*>(p);
+                    return R(e, e + n / sizeof(element_t));
+                }
+            };
+    }
+
+    /**
+     * Cache in a file backed, memory mapped arena which holds a hash table
+     * of entries and their values. All references within the file are
+     * offsets, so the file is usable right after mapping it again, e.g.
+     * after a restart: nothing is deserialized, and pages are read from
+     * the file lazily as entries are accessed.
+     *
+     * Results must not be or contain pointers: they would be stored as
+     * addresses, which mean nothing in the next process. Pointers are
+     * rejected at compile time, pointer members of structs are not.
+     *
+     * The file is locked for the lifetime of the cache, as only one
+     * process may use it at a time. Replaced values are not reclaimed.
+     */
+    class mapped_memory : public detail::cache_base<mapped_memory, true>{
+        struct header;
+        struct slot;
+        std::string m_path;
+        int m_fd;
+        char* m_base;
+        std::size_t m_size;
+        mutable std::mutex m_mutex;
+
+        header& head()const{ return *reinterpret_cast<header*>(m_base); }
+        bool consistent()const;
+        slot* table()const;
+        slot* find_slot(std::uint64_t seed)const;
+        void reserve(std::size_t bytes);
+        std::uint64_t allocate(std::size_t bytes);
+        void grow_table();
+        // the value of seed and its length, or NULL
+        const char* find(std::uint64_t seed, std::size_t& bytes)const;
+        void store(std::uint64_t seed, const char* data, std::size_t bytes);
+      public:
+        explicit mapped_memory(const std::string& path, std::size_t initial_size = 1 << 20);
+        ~mapped_memory();
+        mapped_memory(const mapped_memory&) = delete;
+        mapped_memory& operator=(const mapped_memory&) = delete;
+
+        /// number of entries.
+        std::size_t size()const;
+        /// write changes back to the file now, instead of when the kernel chooses to.
+        void flush()const;
+
+        template<typename R>
+            boost::optional<R> get(const std::string& descr, std::size_t seed)const{
+                std::lock_guard<std::mutex> lock(m_mutex);
+                std::size_t n;
+                const char* p = find(seed, n);
+                if(!p)
+                    return boost::none;
+                boost::optional<R> ret = detail::mapped_layout<R>::load(p, n);
+                if(ret)
+                    MEMOIZATION_LOG(info) << "Cached access from " << m_path;
+                else
+                    MEMOIZATION_LOG(warning) << "Ignoring entry of " << descr << " in " << m_path << " with wrong size";
+                return ret;
+            }
+        template<typename R>
+            void put(const std::string&, std::size_t seed, const R& value)const{
+                typedef detail::mapped_layout<R> layout;
+                std::lock_guard<std::mutex> lock(m_mutex);
+                const_cast<mapped_memory*>(this)->store(seed, layout::data(value), layout::bytes(value));
+            }
+    };
+}
+#endif /* __MEMOIZATION_MAPPED_HPP_295387__ */
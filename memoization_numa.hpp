@@ -0,0 +1,74 @@
+/**
+ * An in-memory cache with one partition per NUMA node. Link with
+ * memoization.cpp.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_NUMA_HPP_295387__
+#     define __MEMOIZATION_NUMA_HPP_295387__
+#include "memoization_core.hpp"
+
+namespace memoization{
+    namespace detail{
+        // NUMA topology through system calls, without libnuma. Single node where unsupported.
+        unsigned numa_nodes();
+        /// the node of the CPU the calling thread runs on.
+        unsigned current_node();
+    }
+
+    /**
+     * In-memory cache with one partition per NUMA node.
+     *
+     * Results are stored in the partition of the node the storing thread
+     * runs on, and allocated by that thread, so the kernel places them in
+     * that node's memory. Lookups try the local partition first and fall
+     * back to the others. With replicate, results found remotely are
+     * copied into the local partition, so that each node ends up with its
+     * own copy of the entries it uses.
+     */
+    class numa_memory : public detail::cache_base<numa_memory>{
+        std::vector<std::unique_ptr<memory> > m_nodes;
+        bool m_replicate;
+
+        memory& local()const{ return *m_nodes[detail::current_node() % m_nodes.size()]; }
+      public:
+        /// zero nodes: as many as the machine has.
+        explicit numa_memory(bool replicate = false, unsigned nodes = 0):m_replicate(replicate){
+            for(unsigned i = 0; i < (nodes ? nodes : detail::numa_nodes()); i++)
+                m_nodes.emplace_back(new memory());
+        }
+        unsigned nodes()const{ return m_nodes.size(); }
+        /// the partition of node i, e.g. to set its capacity.
+        memory& node(unsigned i){ return *m_nodes[i]; }
+
+        template<typename R>
+            boost::optional<R> get(const std::string& descr, std::size_t seed)const{
+                memory& l = local();
+                boost::optional<R> ret = l.get<R>(descr, seed);
+                if(ret)
+                    return ret;
+                for(const auto& n : m_nodes){
+                    if(n.get() == &l)
+                        continue;
+                    ret = n->get<R>(descr, seed);
+                    if(ret){
+                        MEMOIZATION_LOG(info) << "Cached access from remote node";
+                        if(m_replicate)
+                            l.put(descr, seed, *ret);
+                        return ret;
+                    }
+                }
+                return boost::none;
+            }
+        template<typename R>
+            void put(const std::string& descr, std::size_t seed, const R& value)const{
+                local().put(descr, seed, value);
+            }
+        template<typename R>
+            void put_many(const std::string& descr, const std::vector<std::size_t>& seeds, const std::vector<R>& values)const{
+                local().put_many(descr, seeds, values);
+            }
+    };
+}
+#endif /* __MEMOIZATION_NUMA_HPP_295387__ */
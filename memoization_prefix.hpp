@@ -0,0 +1,94 @@
+/**
+ * Memoization of prefixes of lazily generated sequences. Builds on
+ * typed_memory.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_PREFIX_HPP_295387__
+#     define __MEMOIZATION_PREFIX_HPP_295387__
+#include "memoization_core.hpp"
+
+namespace memoization{
+    /**
+     * Memoizes sequences which are produced lazily: make(args...) returns
+     * a generator g, and each g() returns the next element as a
+     * boost::optional, boost::none at the end of the sequence.
+     *
+     * m(n, args...) returns the first n elements (fewer if the sequence
+     * ends before). The elements produced so far and the generator are
+     * kept in a typed_memory, so asking for a longer prefix later resumes
+     * the generator instead of starting over.
+     */
+    template<typename Make>
+    struct prefix_memoize{
+        template<typename Generator, typename... Args>
+        struct table{
+            typedef std::tuple<Args...> key_t;
+            typedef typename std::decay<decltype(std::declval<Generator&>()())>::type::value_type element_t;
+            struct sequence{
+                std::mutex m_mutex; // held while generating
+                std::vector<element_t> m_prefix;
+                boost::optional<Generator> m_generator; // none before the start and after the end
+                bool m_started = false;
+            };
+            std::mutex m_mutex;
+            std::unordered_map<std::tuple<Args...>, std::shared_ptr<sequence>, detail::tuple_hash> m_data;
+        };
+        template<typename... Params>
+        struct table_for{
+            typedef table<typename std::decay<decltype(std::declval<const Make&>()(std::declval<Params>()...))>::type,
+                          typename detail::key_type<Params>::type...> type;
+        };
+
+        Make m_make;
+        std::string m_id;
+        typed_memory& m_fc;
+        typed_memory::cached_table m_table;
+        prefix_memoize(typed_memory& fc, std::string id, const Make& make)
+            :m_make(make), m_id(id), m_fc(fc){}
+
+        template<typename... Params>
+        std::vector<typename table_for<Params&&...>::type::element_t> operator()(std::size_t n, Params&&... args){
+            typedef typename table_for<Params&&...>::type table_t;
+            typedef typename table_t::element_t element_t;
+            table_t& t = m_table.get<table_t>(m_fc, m_id);
+
+            typename table_t::sequence* s;
+            {
+                std::lock_guard<std::mutex> lock(t.m_mutex);
+                std::shared_ptr<typename table_t::sequence>& p = t.m_data[typename table_t::key_t(args...)];
+                if(!p)
+                    p = std::make_shared<typename table_t::sequence>();
+                s = p.get();
+            }
+            std::lock_guard<std::mutex> lock(s->m_mutex);
+            std::size_t cached = s->m_prefix.size();
+            if(n > 0 && !s->m_started){
+                s->m_generator.emplace(m_make(std::forward<Params>(args)...));
+                s->m_started = true;
+            }
+            while(s->m_prefix.size() < n && s->m_generator){
+                boost::optional<element_t> e = (*s->m_generator)();
+                if(e)
+                    s->m_prefix.push_back(std::move(*e));
+                else
+                    s->m_generator = boost::none;
+            }
+            if(s->m_prefix.size() == cached)
+                MEMOIZATION_LOG(info) << "Cached access to prefix of " << m_id;
+            else
+                MEMOIZATION_LOG(info) << "Generated elements " << cached << " to " << s->m_prefix.size() << " of " << m_id;
+            n = std::min(n, s->m_prefix.size());
+            return std::vector<element_t>(s->m_prefix.begin(), s->m_prefix.begin() + n);
+        }
+    };
+
+    /// memoize prefixes of the sequences generated by make(args...), see prefix_memoize.
+    template<typename Make>
+    prefix_memoize<Make>
+    make_prefix_memoized(typed_memory& fc, const std::string& id, Make make){
+        return prefix_memoize<Make>(fc, id, make);
+    }
+}
+#endif /* __MEMOIZATION_PREFIX_HPP_295387__ */
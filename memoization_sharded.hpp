@@ -0,0 +1,114 @@
+/**
+ * An in-memory cache split into shards, which replicates its hottest
+ * entries per thread.
+ *
+ * Published under three-clause BSD license.
+ * Copyright 2014 Hannes Schulz <schulz@ais.uni-bonn.de>
+ */
+#ifndef __MEMOIZATION_SHARDED_HPP_295387__
+#     define __MEMOIZATION_SHARDED_HPP_295387__
+#include <thread>
+#include <unordered_set>
+#include "memoization_core.hpp"
+
+namespace memoization{
+    /**
+     * In-memory cache split into shards by key, each with its own lock, for
+     * many threads looking up concurrently.
+     *
+     * Keys which receive at least replicate_after of the last window
+     * lookups of their shard are copied into per-thread replica slots, so
+     * that reads of the hottest entries do not all contend for one shard.
+     * As results are pure functions of their keys, replicas are never
+     * invalidated; at most max_replicated keys are replicated. This cache
+     * has no quotas.
+     */
+    class sharded_memory : public detail::cache_base<sharded_memory>{
+        struct shard{
+            std::mutex m_mutex;
+            std::unordered_map<std::size_t, detail::any_value> m_data;
+            detail::heavy_hitters m_hot;
+            std::size_t m_lookups;
+            std::unordered_set<std::size_t> m_replicated;
+            char m_pad[64]; // keep shards on separate cache lines
+            shard():m_hot(16), m_lookups(0){}
+        };
+        struct replica{
+            std::mutex m_mutex;
+            std::unordered_map<std::size_t, detail::any_value> m_data;
+            char m_pad[64];
+        };
+        std::vector<std::unique_ptr<shard> > m_shards;
+        std::vector<std::unique_ptr<replica> > m_replicas;
+        std::size_t m_replicate_after, m_window, m_max_replicated;
+        mutable std::atomic<std::size_t> m_replicated;
+
+        replica& my_replica()const{
+            return *m_replicas[std::hash<std::thread::id>()(std::this_thread::get_id()) % m_replicas.size()];
+        }
+        void replicate(std::size_t seed, const detail::any_value& value)const{
+            MEMOIZATION_LOG(info) << "Replicating hot key " << seed;
+            for(const auto& r : m_replicas){
+                std::lock_guard<std::mutex> lock(r->m_mutex);
+                r->m_data[seed] = value;
+            }
+        }
+      public:
+        /// zero shards or replicas: one per hardware thread.
+        explicit sharded_memory(std::size_t shards = 0, std::size_t replicas = 0,
+                std::size_t replicate_after = 64, std::size_t window = 4096, std::size_t max_replicated = 64)
+            :m_replicate_after(replicate_after), m_window(window), m_max_replicated(max_replicated), m_replicated(0){
+            std::size_t n = std::max(std::thread::hardware_concurrency(), 1u);
+            for(std::size_t i = 0; i < (shards ? shards : n); i++)
+                m_shards.emplace_back(new shard());
+            for(std::size_t i = 0; i < (replicas ? replicas : n); i++)
+                m_replicas.emplace_back(new replica());
+        }
+        /// number of replicated keys.
+        std::size_t replicated()const{ return m_replicated; }
+
+        template<typename R>
+            boost::optional<R> get(const std::string&, std::size_t seed)const{
+                if(m_replicated){
+                    replica& r = my_replica();
+                    std::lock_guard<std::mutex> lock(r.m_mutex);
+                    auto it = r.m_data.find(seed);
+                    if(it != r.m_data.end()){
+                        MEMOIZATION_LOG(info) << "Cached access from replica";
+                        return it->second.get<R>();
+                    }
+                }
+                shard& s = *m_shards[seed % m_shards.size()];
+                detail::any_value hot;
+                boost::optional<R> ret;
+                {
+                    std::lock_guard<std::mutex> lock(s.m_mutex);
+                    if(++s.m_lookups >= m_window){
+                        s.m_hot.clear();
+                        s.m_lookups = 0;
+                    }
+                    auto it = s.m_data.find(seed);
+                    s.m_hot.access(seed, it != s.m_data.end());
+                    if(it == s.m_data.end())
+                        return boost::none;
+                    MEMOIZATION_LOG(info) << "Cached access from memory";
+                    ret = it->second.get<R>();
+                    if(s.m_hot.count(seed) >= m_replicate_after && m_replicated < m_max_replicated
+                            && s.m_replicated.insert(seed).second){
+                        m_replicated++;
+                        hot = it->second; // shares the value
+                    }
+                }
+                if(!hot.empty())
+                    replicate(seed, hot);
+                return ret;
+            }
+        template<typename R>
+            void put(const std::string&, std::size_t seed, const R& value)const{
+                shard& s = *m_shards[seed % m_shards.size()];
+                std::lock_guard<std::mutex> lock(s.m_mutex);
+                s.m_data[seed] = value;
+            }
+    };
+}
+#endif /* __MEMOIZATION_SHARDED_HPP_295387__ */
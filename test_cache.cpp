@@ -1,4 +1,10 @@
 #include <iostream>
+#include <fstream>
+#include <thread>
+#include <atomic>
+#include <numeric>
+#include <sys/stat.h>
+#include <boost/filesystem/operations.hpp>
 #include <boost/serialization/vector.hpp>
 #include "memoization.hpp"
 
@@ -61,6 +67,654 @@ void test_cache(Cache& c, int i){
     assert(fib3(i+4) == fib(i+4));
 }
 
+template<class Cache>
+void test_quota(Cache& c){
+    using memoization::quota;
+    // a chatty function must not push everything else out of the cache
+    c.set_capacity(quota(20));
+    c.set_quota("chatty", quota(10));
+    CACHED(c, fib, 20);
+    for(int i = 0; i < 100; i++)
+        c("chatty", [](int i){return i;}, i);
+    assert(c.used("chatty").entries == 10);
+    assert(c.used("fib").entries == 1);
+
+    // a full cache is shared in proportion to the weights
+    c.set_quota("light", quota(0, 0, 1));
+    c.set_quota("heavy", quota(0, 0, 3));
+    for(int i = 0; i < 100; i++){
+        c("light", [](int i){return i;}, i);
+        c("heavy", [](int i){return i;}, i);
+    }
+    assert(c.used().entries == 20);
+    assert(c.used("heavy").entries == 3 * c.used("light").entries);
+}
+
+std::atomic<int> n_batch_calls(0);
+std::vector<long> fib_batch(const std::vector<long>& v){
+    n_batch_calls++;
+    std::vector<long> res;
+    for(long i : v)
+        res.push_back(fib(i));
+    return res;
+}
+
+template<class Cache>
+void test_batch(Cache& c){
+    // missed arguments are computed by a single call of the batch function
+    auto bfib = memoization::make_memoized(c, "bfib", fib, fib_batch);
+    std::vector<long> args = {10, 11, 12, 10};
+    n_batch_calls = 0;
+    std::vector<long> res = bfib.batch(args);
+    assert(n_batch_calls == 1);
+    for(std::size_t i = 0; i < args.size(); i++)
+        assert(res[i] == fib(args[i]));
+
+    // scalar and batch lookups share the cache
+    assert(bfib(13) == fib(13));
+    args.push_back(13);
+    res = bfib.batch(args);
+    assert(n_batch_calls == 1);
+    assert(res.back() == fib(13));
+    // as in the README
+    res = bfib.batch({10, 11, 12});
+    assert(n_batch_calls == 1 && res[2] == fib(12));
+
+    // functions of several arguments are batched over tuples
+    typedef std::tuple<long, long> pair_t;
+    auto add = memoization::make_memoized(c, "add", [](long a, long b){ return a + b; },
+            [](const std::vector<pair_t>& v){
+                std::vector<long> res;
+                for(const pair_t& p : v)
+                    res.push_back(std::get<0>(p) + std::get<1>(p));
+                return res;
+            });
+    std::vector<pair_t> pairs = {pair_t(1, 2), pair_t(3, 4)};
+    assert(add.batch(pairs)[1] == 7);
+    assert(add.batch({pair_t(5, 6)})[0] == 11);
+}
+
+template<class Cache>
+void test_coalesce(Cache& c){
+    // concurrent misses within the window end up in a single batch
+    auto bfib = memoization::make_memoized(c, "cfib", fib, fib_batch);
+    bfib.coalesce(std::chrono::milliseconds(200), 8);
+    n_batch_calls = 0;
+    std::vector<std::thread> threads;
+    std::vector<long> res(8);
+    for(int i = 0; i < 8; i++)
+        threads.push_back(std::thread([&, i]{ res[i] = bfib(long(i + 10)); }));
+    for(auto& t : threads)
+        t.join();
+    assert(n_batch_calls < 8);
+    for(int i = 0; i < 8; i++)
+        assert(res[i] == fib(i + 10));
+    assert(bfib(10) == fib(10));
+    assert(n_batch_calls < 8);
+}
+
+struct colliding{
+    int i;
+    bool operator==(const colliding& o)const{ return i == o.i; }
+};
+std::size_t hash_value(const colliding&){ return 0; }
+int unwrap(const colliding& c){ return c.i; }
+
+void test_typed(memoization::typed_memory& c){
+    // arguments are compared exactly, even if their hashes collide
+    colliding a = {1}, b = {2};
+    assert(CACHED(c, unwrap, a) == 1);
+    assert(CACHED(c, unwrap, b) == 2);
+    auto munwrap = memoization::make_memoized(c, "unwrap", unwrap);
+    assert(munwrap(a) == 1 && munwrap(b) == 2);
+
+    // C strings are stored by value
+    auto first = [](const std::string& s){ return s.substr(0, 1); };
+    assert(CACHED(c, first, "a") == "a");
+    assert(CACHED(c, first, std::string("b")) == "b");
+}
+
+// neither default constructible nor copyable
+struct matrix{
+    int rows;
+    std::vector<double> data;
+    explicit matrix(int r):rows(r), data(r * r){}
+    matrix(matrix&&) = default;
+    matrix(const matrix&) = delete;
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int){ ar & data; }
+};
+namespace boost{ namespace serialization{
+    template<class Archive>
+    void save_construct_data(Archive& ar, const matrix* m, const unsigned int){ ar << m->rows; }
+    template<class Archive>
+    void load_construct_data(Archive& ar, matrix* m, const unsigned int){
+        int rows;
+        ar >> rows;
+        ::new(m) matrix(rows);
+    }
+}}
+
+matrix eye(int n){
+    matrix m(n);
+    for(int i = 0; i < n; i++)
+        m.data[i * n + i] = 1;
+    return m;
+}
+
+void test_construct(memoization::disk& c){
+    // results are constructed in place through load_construct_data
+    matrix m1 = CACHED(c, eye, 3);
+    matrix m2 = CACHED(c, eye, 3);
+    assert(m2.rows == 3);
+    assert(m1.data == m2.data);
+}
+
+void test_io(std::shared_ptr<memoization::io::engine> writer, std::shared_ptr<memoization::io::engine> reader){
+    // batches are written through one engine and read back through another
+    boost::filesystem::remove_all("cache_test/io");
+    std::vector<long> args;
+    for(long i = 0; i < 25; i++)
+        args.push_back(i);
+    memoization::disk c1("cache_test/io");
+    c1.set_io_engine(writer);
+    auto bfib1 = memoization::make_memoized(c1, "iofib", fib, fib_batch);
+    n_batch_calls = 0;
+    std::vector<long> res1 = bfib1.batch(args);
+    assert(n_batch_calls == 1);
+
+    memoization::disk c2("cache_test/io");
+    c2.set_io_engine(reader);
+    auto bfib2 = memoization::make_memoized(c2, "iofib", fib, fib_batch);
+    std::vector<long> res2 = bfib2.batch(args);
+    assert(n_batch_calls == 1);
+    assert(res1 == res2);
+    assert(res2[20] == fib(20));
+}
+
+void test_direct_io(memoization::disk& c){
+    // large entries bypass the page cache, small ones do not
+    c.set_direct_io(4096);
+    std::vector<int> v(100000, 3), small(10, 3);
+    assert(CACHED(c, times, v, 5) == times(v, 5));
+    assert(CACHED(c, times, v, 5) == times(v, 5));
+    assert(CACHED(c, times, small, 5) == times(small, 5));
+    assert(CACHED(c, times, small, 5) == times(small, 5));
+}
+
+int n_square_calls = 0;
+int square(int i){
+    n_square_calls++;
+    return i * i;
+}
+
+void test_generations(){
+    {
+        memoization::disk c("cache_test/generations");
+        c.set_generation("1");
+        c.mark_stable("stable");
+        c("stable", square, 3);
+        c("unstable", square, 3);
+    }
+    n_square_calls = 0;
+    memoization::disk c("cache_test/generations");
+    c.set_generation("2");
+    c.mark_stable("stable");
+    // results of a new build are recomputed, unless marked stable
+    c("stable", square, 3);
+    assert(n_square_calls == 0);
+    c("unstable", square, 3);
+    assert(n_square_calls == 1);
+
+    // stable results survive the removal of old generations
+    c.remove_old_generations();
+    memoization::disk c2("cache_test/generations");
+    c2.set_generation("2");
+    c2("stable", square, 3);
+    assert(n_square_calls == 1);
+
+    assert(!memoization::build_id().empty());
+}
+
+int n_sum_calls = 0;
+double sum(const std::shared_ptr<const std::vector<double> >& v){
+    n_sum_calls++;
+    double s = 0;
+    for(double d : *v)
+        s += d;
+    return s;
+}
+
+template<class Cache>
+void test_identity(Cache& c){
+    // keyed by the object, not its content
+    auto big = std::make_shared<std::vector<double> >(100000, 1.0);
+    auto copy = std::make_shared<std::vector<double> >(*big);
+    n_sum_calls = 0;
+    assert(CACHED(c, sum, memoization::by_identity(big)) == 100000);
+    assert(CACHED(c, sum, memoization::by_identity(big)) == 100000);
+    assert(CACHED(c, sum, memoization::by_identity(copy)) == 100000);
+    assert(n_sum_calls == 2);
+
+    // a new object is never mistaken for a destroyed one, even at the same address
+    big.reset();
+    big = std::make_shared<std::vector<double> >(10, 1.0);
+    assert(CACHED(c, sum, memoization::by_identity(big)) == 10);
+    assert(n_sum_calls == 3);
+}
+
+// not hashable, and only a and b matter
+struct request{
+    int a, b;
+    std::string payload;
+};
+int n_request_calls = 0;
+int handle(const request& r){
+    n_request_calls++;
+    return r.a + r.b;
+}
+
+template<class Cache>
+void test_projection(Cache& c){
+    auto mhandle = memoization::make_memoized(c, "handle", handle,
+            memoization::key_by([](const request& r){ return std::make_tuple(r.a, r.b); }));
+    request r1 = {1, 2, "first"}, r2 = {1, 2, "second"}, r3 = {2, 1, "first"};
+    n_request_calls = 0;
+    assert(mhandle(r1) == 3);
+    assert(mhandle(r2) == 3);
+    assert(n_request_calls == 1);
+    assert(mhandle(r3) == 3);
+    assert(n_request_calls == 2);
+}
+
+int n_scale_calls = 0;
+double scale(double x, int n){
+    n_scale_calls++;
+    return x * n;
+}
+
+template<class Cache>
+void test_quantize(Cache& c){
+    using namespace memoization::tolerance;
+    auto mscale = memoization::make_memoized(c, "scale", scale,
+            memoization::quantize(absolute(1e-9), exact()));
+    n_scale_calls = 0;
+    mscale(0.1 + 0.2, 2);
+    mscale(0.3, 2);
+    assert(n_scale_calls == 1);
+    mscale(0.3, 3);
+    mscale(0.3 + 1e-6, 2);
+    assert(n_scale_calls == 3);
+    // far more buckets than fit into an integer
+    assert(mscale(1e10, 1) == 1e10);
+    assert(mscale(2e10, 1) == 2e10);
+    assert(mscale(-5e10, 1) == -5e10);
+    assert(n_scale_calls == 6);
+
+    auto rscale = memoization::make_memoized(c, "rscale", scale,
+            memoization::quantize(relative(1e-6), exact()));
+    n_scale_calls = 0;
+    rscale(1e10, 1);
+    rscale(1e10 * (1 + 1e-12), 1);
+    assert(n_scale_calls == 1);
+    rscale(1e10 * 1.01, 1);
+    assert(n_scale_calls == 2);
+}
+
+int n_area_calls = 0;
+struct rect : memoization::versioned{
+    double w, h;
+    rect(double w_, double h_):w(w_), h(h_){}
+    void set_width(double w_){ w = w_; touch(); }
+    double area(double scale)const{ n_area_calls++; return w * h * scale; }
+};
+struct circle{
+    double r;
+    double area()const{ n_area_calls++; return 3 * r * r; }
+};
+std::size_t hash_value(const circle& c){ return boost::hash<double>()(c.r); }
+
+template<class Cache>
+void test_member(Cache& c){
+    auto area = memoization::make_memoized(c, "rect::area", &rect::area);
+    rect a(2, 3), b(2, 3);
+    n_area_calls = 0;
+    assert(area(a, 1.0) == 6 && area(a, 1.0) == 6);
+    assert(n_area_calls == 1);
+    // other objects and other states are other keys
+    assert(area(b, 1.0) == 6);
+    a.set_width(1);
+    assert(area(a, 1.0) == 3);
+    assert(n_area_calls == 3);
+
+    // keyed by the hash of the state
+    auto carea = memoization::make_memoized(c, "circle::area", &circle::area);
+    circle c1 = {1}, c2 = {1};
+    n_area_calls = 0;
+    assert(carea(c1) == 3 && carea(c2) == 3);
+    assert(n_area_calls == 1);
+}
+
+std::vector<long> series(1000, 0);
+std::vector<std::pair<long, long> > summed;
+long range_sum(long begin, long end){
+    summed.push_back(std::make_pair(begin, end));
+    long s = 0;
+    for(long i = begin; i < end; i++)
+        s += series[i];
+    return s;
+}
+
+long expected_sum(long begin, long end){
+    return std::accumulate(series.begin() + begin, series.begin() + end, 0L);
+}
+
+void test_intervals(memoization::typed_memory& c){
+    for(std::size_t i = 0; i < series.size(); i++)
+        series[i] = i % 7;
+    auto msum = memoization::make_interval_memoized(c, "range_sum", range_sum,
+            [](long a, long b){ return a + b; });
+    summed.clear();
+    assert(msum(100, 200) == expected_sum(100, 200));
+    assert(msum(300, 400) == expected_sum(300, 400));
+    // only the gaps are computed
+    assert(msum(50, 450) == expected_sum(50, 450));
+    assert(summed.size() == 5);
+    assert(summed[2] == std::make_pair(50L, 100L));
+    assert(summed[3] == std::make_pair(200L, 300L));
+    assert(summed[4] == std::make_pair(400L, 450L));
+    // pieces which stick out of the range are not used: [200, 300) is
+    assert(msum(150, 350) == expected_sum(150, 350));
+    assert(summed.size() == 7);
+    assert(summed[5] == std::make_pair(150L, 200L));
+    assert(summed[6] == std::make_pair(300L, 350L));
+    assert(msum(50, 450) == expected_sum(50, 450));
+    assert(msum(150, 350) == expected_sum(150, 350));
+    assert(summed.size() == 7);
+}
+
+int n_times_calls = 0;
+std::vector<int> counted_times(const std::vector<int>& v, int factor){
+    n_times_calls++;
+    return times(v, factor);
+}
+
+void test_compress(){
+    memoization::memory c;
+    c.compress_cold(std::chrono::milliseconds(20));
+    n_times_calls = 0;
+    std::vector<int> v(100000, 3);
+    std::vector<int> r = CACHED(c, counted_times, v, 2);
+    std::size_t bytes = c.used().bytes;
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    assert(c.used().bytes * 10 < bytes);
+
+    // decompressed on the next hit
+    assert(CACHED(c, counted_times, v, 2) == r);
+    assert(n_times_calls == 1);
+    assert(c.used().bytes == bytes);
+    c.compress_cold(std::chrono::milliseconds(0));
+}
+
+ino_t inode(const std::string& fn){
+    struct stat st;
+    assert(::stat(fn.c_str(), &st) == 0);
+    return st.st_ino;
+}
+
+void test_unchanged(memoization::disk& c){
+    // identical results are not rewritten
+    c.put("unchanged", 1, std::string("abc"));
+    ino_t first = inode(c.filename("unchanged", 1));
+    c.put("unchanged", 1, std::string("abc"));
+    assert(inode(c.filename("unchanged", 1)) == first);
+    c.put("unchanged", 1, std::string("abd"));
+    assert(inode(c.filename("unchanged", 1)) != first);
+    assert(*c.get<std::string>("unchanged", 1) == "abd");
+}
+
+int n_generated = 0;
+// squares from start on, up to 100
+std::function<boost::optional<long>()> squares(long start){
+    return [start]() mutable -> boost::optional<long> {
+        if(start > 10)
+            return boost::none;
+        n_generated++;
+        long i = start++;
+        return i * i;
+    };
+}
+
+void test_prefix(memoization::typed_memory& c){
+    auto msquares = memoization::make_prefix_memoized(c, "squares", squares);
+    n_generated = 0;
+    assert(msquares(3, 1) == std::vector<long>({1, 4, 9}));
+    assert(n_generated == 3);
+    assert(msquares(2, 1) == std::vector<long>({1, 4}));
+    assert(n_generated == 3);
+    // resumes where it stopped
+    assert(msquares(5, 1).back() == 25);
+    assert(n_generated == 5);
+    // the sequence ends
+    assert(msquares(100, 1).size() == 10);
+    assert(msquares(200, 1).size() == 10);
+    assert(n_generated == 10);
+    assert(msquares(2, 9) == std::vector<long>({81, 100}));
+    assert(msquares(0, 11).empty() && msquares(5, 11).empty());
+}
+
+void test_mapped(){
+    auto first = [](const std::string& s){ return s.substr(0, 1); };
+    std::vector<int> v(10000, 2);
+    {
+        memoization::mapped_memory c("cache_test/mapped", 4096);
+        n_square_calls = n_times_calls = 0;
+        for(int i = 0; i < 1000; i++)
+            assert(CACHED(c, square, i) == i * i);
+        assert(n_square_calls == 1000);
+        assert(CACHED(c, counted_times, v, 3)[0] == 6);
+        assert(c("first", first, std::string("xyz")) == "x");
+    }
+    // usable after mapping the file again
+    memoization::mapped_memory c("cache_test/mapped");
+    assert(c.size() == 1002);
+    for(int i = 0; i < 1000; i++)
+        assert(CACHED(c, square, i) == i * i);
+    assert(CACHED(c, counted_times, v, 3) == times(v, 3));
+    assert(c("first", first, std::string("xyz")) == "x");
+    assert(n_square_calls == 1000 && n_times_calls == 1);
+}
+
+void test_mapped_damaged(){
+    {
+        memoization::mapped_memory c("cache_test/mapped_damaged");
+        for(int i = 0; i < 10; i++)
+            CACHED(c, square, i);
+    }
+    // a slot table far outside the file is not followed; the cache starts over
+    std::uint64_t table = std::uint64_t(1) << 40;
+    {
+        std::fstream f("cache_test/mapped_damaged", std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(2 * sizeof(table));
+        f.write(reinterpret_cast<const char*>(&table), sizeof(table));
+    }
+    memoization::mapped_memory c("cache_test/mapped_damaged");
+    assert(c.size() == 0);
+    n_square_calls = 0;
+    assert(CACHED(c, square, 3) == 9);
+    assert(n_square_calls == 1);
+}
+
+void test_hot(memoization::memory& c){
+    c.track_hot(8);
+    for(int i = 0; i < 100; i++){
+        c("square", square, 7);
+        if(i % 2 == 0)
+            c("square", square, 3);
+        c("square", square, 1000 + i);
+    }
+    memoization::statistics s = c.stats("square");
+    assert(s.misses == 102 && s.hits == 148);
+    assert(s.hot.size() == 8);
+    assert(s.hot[0].seed == memoization::detail::hash_combine(0, std::string("square"), 7));
+    assert(s.hot[0].count == 100 && s.hot[0].hits == 99);
+    assert(s.hot[1].seed == memoization::detail::hash_combine(0, std::string("square"), 3));
+    assert(s.hot[0].seconds > 0);
+    c.track_hot(0);
+}
+
+void test_sharded(){
+    memoization::sharded_memory c(4, 4, 16);
+    std::atomic<long> sum(0);
+    std::vector<std::thread> threads;
+    for(int t = 0; t < 4; t++)
+        threads.emplace_back([&c, &sum, t](){
+            for(int i = 0; i < 200; i++)
+                sum += c("fib", fib, i % 50 ? 20L : long(t));
+        });
+    for(std::thread& t : threads)
+        t.join();
+    assert(sum == 4 * 196 * fib(20) + 4 * (0 + 1 + 1 + 2));
+    // only the hot key is replicated
+    assert(c.replicated() == 1);
+}
+
+void test_numa(){
+    assert(memoization::detail::numa_nodes() >= 1);
+    assert(memoization::detail::current_node() < memoization::detail::numa_nodes());
+
+    memoization::numa_memory c;
+    n_square_calls = 0;
+    c("square", square, 5);
+    c("square", square, 5);
+    assert(n_square_calls == 1);
+
+    // as if the entry was stored by a thread on another node
+    memoization::numa_memory r(true, 2);
+    unsigned other = (memoization::detail::current_node() + 1) % 2;
+    r.node(other).put("square", 42, 1764);
+    assert(*r.get<int>("square", 42) == 1764);
+    assert(r.node(1 - other).used().entries == 1);
+}
+
+void test_throttle(){
+    memoization::disk c("cache_test/throttle");
+    c.set_write_limit(0, 20); // 20 writes per second
+    auto start = std::chrono::steady_clock::now();
+    n_square_calls = 0;
+    for(int i = 0; i < 40; i++)
+        c("square", square, i);
+    // lookups neither wait nor miss queued entries
+    assert(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(500));
+    for(int i = 0; i < 40; i++)
+        assert(c("square", square, i) == i * i);
+    assert(n_square_calls == 40);
+    c.flush();
+    assert(std::chrono::steady_clock::now() - start > std::chrono::milliseconds(900));
+    assert(boost::filesystem::exists(c.filename("square", memoization::detail::hash_combine(0, std::string("square"), 39))));
+
+    // an entry which waits for tokens is not written after it was erased
+    memoization::disk e("cache_test/throttle_erase");
+    e.set_write_limit(0, 1);
+    e.put("erased", 1, 1);
+    e.put("erased", 2, 2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    e.erase("erased", 2);
+    e.flush();
+    std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+    assert(boost::filesystem::exists(e.filename("erased", 1)));
+    assert(!boost::filesystem::exists(e.filename("erased", 2)));
+}
+
+struct progress{
+    long i, sum;
+    template<class Archive>
+    void serialize(Archive& ar, const unsigned int){ ar & i & sum; }
+};
+int n_steps = 0;
+bool crash = true;
+long slow_sum(memoization::checkpoint<progress>& cp, long n){
+    progress p = {0, 0};
+    if(cp.restored())
+        p = *cp.restored();
+    while(p.i < n){
+        if(p.i == n / 2 && crash)
+            throw std::runtime_error("killed");
+        p.sum += p.i++;
+        n_steps++;
+        cp.update(p);
+    }
+    return p.sum;
+}
+
+void test_checkpoint(){
+    memoization::disk c("cache_test/checkpoint");
+    auto msum = memoization::make_checkpointed<progress>(c, "slow_sum", slow_sum, std::chrono::seconds(0));
+    try{
+        msum(100);
+        assert(false);
+    }catch(const std::runtime_error&){}
+    assert(n_steps == 50);
+    // resumes from the last checkpoint
+    crash = false;
+    assert(msum(100) == 4950);
+    assert(n_steps == 100);
+    assert(msum(100) == 4950);
+    assert(n_steps == 100);
+    std::size_t seed = memoization::detail::hash_combine(0, std::string("slow_sum"), 100);
+    assert(!boost::filesystem::exists(c.filename("slow_sum.checkpoint", seed)));
+}
+
+void test_prefetch(){
+    memoization::disk d("cache_test/prefetch");
+    for(int i = 0; i < 3; i++)
+        d("square", square, i);
+    memoization::prefetching c(d);
+    // entries leave memory before they are used again, so that predictions must load them
+    c.front().set_capacity(memoization::quota(1));
+    n_square_calls = 0;
+    for(int round = 0; round < 3; round++)
+        for(int i = 0; i < 3; i++){
+            assert(c("square", square, i) == i * i);
+            c.wait();
+        }
+    assert(n_square_calls == 0);
+    // 0 -> 1 -> 2 -> 0 is predicted in the third round
+    assert(c.prefetched() == 3);
+
+    // the predicted entry is loaded into memory, although it was evicted
+    memoization::prefetching c2(d, 2, 0); // loads on one thread
+    c2.front().set_capacity(memoization::quota(1));
+    c2("square", square, 0); c2("square", square, 1);
+    c2("square", square, 0); c2("square", square, 1);
+    c2("square", square, 0);
+    c2.wait();
+    assert(c2.front().get<int>("square", memoization::detail::hash_combine(0, std::string("square"), 1)));
+}
+
+constexpr long fib_iter(long n, long a = 0, long b = 1){
+    return n == 0 ? a : fib_iter(n - 1, b, a + b);
+}
+constexpr long cfib(long n){ return fib_iter(n); }
+
+constexpr int popcount(int n){
+    return n == 0 ? 0 : (n & 1) + popcount(n >> 1);
+}
+
+void test_constexpr(){
+    constexpr auto tfib = TABULATED(cfib, 0L, 90L);
+    static_assert(tfib(10) == 55, "evaluated at compile time");
+    for(long i = 0; i < 90; i++)
+        assert(tfib(i) == fib_iter(i));
+    // outside of the table
+    assert(tfib(90) == cfib(90));
+
+    // large domains do not exceed the template depth
+    constexpr auto bits = TABULATED(popcount, 0, 1 << 12);
+    static_assert(bits.size() == 1 << 12 && bits(255) == 8, "");
+    assert(bits(1023) == 10);
+}
+
 int
 main(int argc, char **argv)
 {
@@ -76,5 +730,92 @@ main(int argc, char **argv)
     memoization::memory mem;
     test_cache(mem, atoi(argv[1]));
 
+    // the remaining tests expect to start from an empty disk cache
+    boost::filesystem::remove_all("cache_test");
+
+    memoization::disk qdsk("cache_test/quota");
+    test_quota(qdsk);
+    memoization::memory qmem;
+    test_quota(qmem);
+
+    memoization::disk bdsk("cache_test/batch");
+    test_batch(bdsk);
+    test_batch(mem);
+
+    memoization::disk cdsk("cache_test/coalesce");
+    test_coalesce(cdsk);
+    test_coalesce(mem);
+
+    memoization::disk mdsk("cache_test/construct");
+    test_construct(mdsk);
+
+    auto threads = std::make_shared<memoization::io::thread_pool_engine>(4);
+    test_io(memoization::io::make_engine(), threads);
+    // no threads asked for, one is used
+    test_io(threads, memoization::io::make_engine(0));
+    try{
+        auto uring = std::make_shared<memoization::io::uring_engine>(8);
+        test_io(threads, uring);
+        test_io(uring, uring);
+    }catch(const std::system_error& e){
+        std::cout << "io_uring unavailable: " << e.what() << std::endl;
+    }
+
+    memoization::disk ddsk("cache_test/direct");
+    test_direct_io(ddsk);
+
+    test_generations();
+
+    memoization::typed_memory tmem;
+    test_cache(tmem, atoi(argv[1]));
+    test_typed(tmem);
+
+    memoization::memory imem;
+    test_identity(imem);
+    // entries of destroyed objects are dropped
+    imem.drop_expired();
+    assert(imem.used().entries == 0);
+    test_identity(tmem);
+    // typed_memory drops them as its table grows
+    typedef memoization::typed_memory::table<double, memoization::identity<std::vector<double> > > sum_table_t;
+    for(int i = 0; i < 200; i++)
+        CACHED(tmem, sum, memoization::by_identity(std::make_shared<std::vector<double> >(1, 1.0)));
+    assert(tmem.get_table<sum_table_t>("sum").m_data.size() < 100);
+
+    test_projection(mem);
+    test_projection(tmem);
+    memoization::disk pdsk("cache_test/projection");
+    test_projection(pdsk);
+
+    test_quantize(mem);
+    test_quantize(tmem);
+
+    test_member(mem);
+    test_member(tmem);
+
+    test_intervals(tmem);
+    test_prefix(tmem);
+
+    test_mapped();
+    test_mapped_damaged();
+
+    test_compress();
+
+    memoization::memory hmem;
+    test_hot(hmem);
+    test_sharded();
+    test_numa();
+
+    memoization::disk udsk("cache_test/unchanged");
+    test_unchanged(udsk);
+    udsk.set_sync(true);
+    udsk.set_direct_io(1);
+    test_unchanged(udsk);
+
+    test_throttle();
+    test_checkpoint();
+    test_prefetch();
+    test_constexpr();
+
     return 0;
 }